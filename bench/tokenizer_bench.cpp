@@ -0,0 +1,661 @@
+#include <vector>
+#include <bitset>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <getopt.h>
+#include <tokenizer/tokenizer.hpp>
+#include <tokenizer/config.h>
+
+#ifndef BENCH_CORPUS_PATH
+#define BENCH_CORPUS_PATH "bench/corpus"
+#endif
+
+/*
+** Minimal benchmark runner in the spirit of Google Benchmark
+** each benchmark body loops while state.keep_running(), the runner grows the iteration count
+** until a run takes at least min_time seconds, then reports time per iteration and throughput
+*/
+struct BenchState
+{
+	long iterations;
+	long remaining;
+	long items_processed; // per iteration, set by the benchmark
+	long bytes_processed; // per iteration, set by the benchmark
+
+	explicit BenchState(long iterations)
+	    : iterations(iterations), remaining(iterations), items_processed(0), bytes_processed(0)
+	{
+	}
+
+	inline bool keep_running()
+	{
+		return remaining-- > 0;
+	}
+};
+
+struct Benchmark
+{
+	std::string name;
+	std::function< void(BenchState &) > body;
+};
+
+struct bench_option
+{
+	double min_time;
+	bool use_mmap;
+	const char *dict_path;
+	const char *corpus_path;
+	const char *filter;
+
+	bench_option()
+	    : min_time(0.5),
+	      use_mmap(false),
+	      dict_path(DICT_PATH),
+	      corpus_path(BENCH_CORPUS_PATH),
+	      filter("")
+	{
+	}
+};
+
+// clang-format off
+static struct option options[] = {
+	{ "help"         , no_argument      , NULL,  0  },
+	{ "dict-path"    , required_argument, NULL, 'd' },
+	{ "corpus-path"  , required_argument, NULL, 'c' },
+	{ "filter"       , required_argument, NULL, 'f' },
+	{ "min-time"     , required_argument, NULL, 't' },
+	{ "mmap"         , no_argument      , NULL, 'm' },
+	{  NULL          , 0                , NULL,  0  }
+};
+// clang-format on
+
+int print_bench_usage(int argc, char **argv)
+{
+	fprintf(stderr,
+		"Usage:\n"
+		"    %s [OPTIONS]\n"
+		"\n"
+		"Options:\n"
+		"    -d, --dict-path <path>   : dictionaries path, default is " DICT_PATH "\n"
+		"    -c, --corpus-path <path> : benchmark corpora path, default is " BENCH_CORPUS_PATH "\n"
+		"    -f, --filter <text>      : only run benchmarks whose name contains text\n"
+		"    -t, --min-time <seconds> : minimal measured time of each benchmark, default is 0.5\n"
+		"    -m, --mmap               : map dictionaries read-only instead of loading them\n"
+		"        --help               : show this message\n\n",
+		argv[0]);
+
+	return 0;
+}
+
+int bench_getopt_parse(int argc, char **argv, bench_option &opts)
+{
+	int option_code;
+	while (~(option_code = getopt_long(argc, argv, "d:c:f:t:m", options, NULL)))
+	{
+		switch (option_code)
+		{
+		case 'd':
+			opts.dict_path = optarg;
+			break;
+		case 'c':
+			opts.corpus_path = optarg;
+			break;
+		case 'f':
+			opts.filter = optarg;
+			break;
+		case 't':
+			opts.min_time = atof(optarg);
+			break;
+		case 'm':
+			opts.use_mmap = true;
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int read_corpus(const std::string &file_path, std::vector< std::string > &lines)
+{
+	std::ifstream in(file_path.c_str());
+	if (!in)
+	{
+		std::cerr << "Cannot open corpus " << file_path << std::endl;
+		return -1;
+	}
+	std::string line;
+	while (std::getline(in, line))
+	{
+		if (!line.empty()) lines.push_back(line);
+	}
+	return 0;
+}
+
+// prevent the compiler from optimizing away a computed value
+template < class T >
+inline void do_not_optimize(const T &value)
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+void run_benchmark(const Benchmark &benchmark, double min_time)
+{
+	typedef std::chrono::steady_clock clock;
+	long iterations = 1;
+	while (true)
+	{
+		BenchState state(iterations);
+		clock::time_point start = clock::now();
+		benchmark.body(state);
+		double elapsed = std::chrono::duration< double >(clock::now() - start).count();
+		if (elapsed >= min_time || iterations >= 1000000000L)
+		{
+			printf("%-40s %12ld %14.1f ns",
+				benchmark.name.c_str(),
+				iterations,
+				elapsed * 1e9 / iterations);
+			if (state.items_processed > 0)
+			{
+				printf(" %12.3fM items/s", state.items_processed * iterations / elapsed / 1e6);
+			}
+			if (state.bytes_processed > 0)
+			{
+				printf(" %10.2f MB/s", state.bytes_processed * iterations / elapsed / 1e6);
+			}
+			printf("\n");
+			fflush(stdout);
+			return;
+		}
+		// aim slightly above min_time, but never grow more than 10x at once
+		double scale = elapsed > 0 ? min_time * 1.4 / elapsed : 10;
+		iterations = std::max(iterations + 1, (long) (iterations * std::min(scale, 10.0)));
+	}
+}
+
+// total size of lines in bytes
+long corpus_bytes(const std::vector< std::string > &lines)
+{
+	long total = 0;
+	for (const std::string &line : lines)
+	{
+		total += line.size();
+	}
+	return total;
+}
+
+struct Corpus
+{
+	std::string name;
+	std::vector< std::string > lines;
+	std::vector< std::vector< uint32_t > > normalized;
+	long bytes;
+	long chars;
+};
+
+int load_corpus(const std::string &corpus_path, const std::string &name, Corpus &corpus)
+{
+	corpus.name = name;
+	if (0 > read_corpus(corpus_path + "/" + name + ".txt", corpus.lines)) return -1;
+	corpus.bytes = corpus_bytes(corpus.lines);
+	corpus.chars = 0;
+	for (const std::string &line : corpus.lines)
+	{
+		std::vector< uint32_t > text;
+		std::vector< int > original_pos;
+		Tokenizer::instance().normalize_for_tokenization(line, text, original_pos);
+		corpus.chars += text.size();
+		corpus.normalized.push_back(text);
+	}
+	return 0;
+}
+
+// normalized texts of exactly length chars, cut from the concatenation of the corpus lines
+std::vector< std::vector< uint32_t > > make_fixed_length_texts(const Corpus &corpus, size_t length, size_t count)
+{
+	std::vector< uint32_t > all;
+	for (const std::vector< uint32_t > &text : corpus.normalized)
+	{
+		all.insert(all.end(), text.begin(), text.end());
+		all.push_back(' ');
+	}
+	std::vector< std::vector< uint32_t > > res;
+	for (size_t i = 0; i < count && all.size() >= length; ++i)
+	{
+		size_t from = (i * 7919 * length) % (all.size() - length + 1);
+		res.push_back(std::vector< uint32_t >(all.begin() + from, all.begin() + from + length));
+	}
+	return res;
+}
+
+// alphanumeric runs of the texts, i.e. the inputs of the sticky-text DP
+std::vector< std::vector< uint32_t > > make_sticky_runs(const Corpus &corpus)
+{
+	std::vector< std::vector< uint32_t > > res;
+	for (const std::vector< uint32_t > &text : corpus.normalized)
+	{
+		size_t from = 0;
+		for (size_t i = 0; i <= text.size(); ++i)
+		{
+			if (i == text.size() || !VnLangTool::is_alphanumeric(text[i]))
+			{
+				if (i > from) res.push_back(std::vector< uint32_t >(text.begin() + from, text.begin() + i));
+				from = i + 1;
+			}
+		}
+	}
+	return res;
+}
+
+// host part of every URL, as the input of TOKENIZE_HOST
+std::vector< std::string > make_hosts(const std::vector< std::string > &urls)
+{
+	std::vector< std::string > res;
+	for (const std::string &url : urls)
+	{
+		size_t from = url.find("://");
+		from = from == std::string::npos ? 0 : from + 3;
+		size_t to = url.find_first_of("/?", from);
+		res.push_back(url.substr(from, to == std::string::npos ? std::string::npos : to - from));
+	}
+	return res;
+}
+
+// Result is std::vector< FullToken > or SegmentedText
+template < class Result = std::vector< FullToken > >
+void add_segment_benchmark(std::vector< Benchmark > &benchmarks,
+	const std::string &name,
+	const std::vector< std::string > &lines,
+	int tokenize_option)
+{
+	benchmarks.push_back({name,
+		[&lines, tokenize_option](BenchState &state)
+		{
+			Tokenizer &tokenizer = Tokenizer::instance();
+			TokenizerWorkspace workspace;
+			Result res;
+			while (state.keep_running())
+			{
+				for (const std::string &line : lines)
+				{
+					tokenizer.segment(line, false, tokenize_option, false, res, workspace);
+					do_not_optimize(&res);
+				}
+			}
+			state.items_processed = lines.size();
+			state.bytes_processed = corpus_bytes(lines);
+		}});
+}
+
+template < class Dump >
+void add_load_benchmark(std::vector< Benchmark > &benchmarks, const std::string &name, const std::string &file_path, bool use_mmap)
+{
+	benchmarks.push_back({name,
+		[file_path, use_mmap](BenchState &state)
+		{
+			while (state.keep_running())
+			{
+				Dump dump;
+				if (0 > (use_mmap ? dump.map_from_file(file_path) : dump.read_from_file(file_path)))
+				{
+					exit(EXIT_FAILURE);
+				}
+				do_not_optimize(dump);
+			}
+		}});
+}
+
+int main(int argc, char **argv)
+{
+	bench_option opts;
+	if (bench_getopt_parse(argc, argv, opts))
+	{
+		print_bench_usage(argc, argv);
+		exit(EXIT_FAILURE);
+	}
+
+	Tokenizer &tokenizer = Tokenizer::instance();
+	if (0 > tokenizer.initialize(opts.dict_path, true, opts.use_mmap))
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	Corpus queries, titles, urls;
+	if (0 > load_corpus(opts.corpus_path, "queries", queries) ||
+		0 > load_corpus(opts.corpus_path, "titles", titles) || 0 > load_corpus(opts.corpus_path, "urls", urls))
+	{
+		exit(EXIT_FAILURE);
+	}
+	std::vector< std::string > hosts = make_hosts(urls.lines);
+	std::vector< std::vector< uint32_t > > sticky_runs = make_sticky_runs(urls);
+
+	std::vector< Benchmark > benchmarks;
+
+	for (const Corpus *corpus : {&queries, &titles, &urls})
+	{
+		benchmarks.push_back({"normalize_for_tokenization/" + corpus->name,
+			[corpus, &tokenizer](BenchState &state)
+			{
+				std::vector< uint32_t > text;
+				std::vector< int > original_pos;
+				while (state.keep_running())
+				{
+					for (const std::string &line : corpus->lines)
+					{
+						text.clear();
+						original_pos.clear();
+						tokenizer.normalize_for_tokenization(line, text, original_pos);
+						do_not_optimize(text.data());
+					}
+				}
+				state.items_processed = corpus->chars;
+				state.bytes_processed = corpus->bytes;
+			}});
+	}
+
+	/*
+	** the per-codepoint lookups of the tokenizer hot loops (is_alphanumeric, lower, tone/hat marks),
+	** on the staged VnLangTool tables and on 64K-entry flat arrays built from them, the previous layout
+	*/
+	struct FlatCharTables
+	{
+		std::bitset< VnLangTool::ALPHANUMERIC_SIZE > in_alphanumeric;
+		std::vector< uint32_t > lower_of;
+		std::vector< int > tone_forms_id;
+		std::vector< int > hat_forms_id;
+	};
+	std::shared_ptr< FlatCharTables > flat(new FlatCharTables());
+	for (uint32_t c = 0; c < (uint32_t) VnLangTool::ALPHANUMERIC_SIZE; ++c)
+	{
+		flat->in_alphanumeric[c] = VnLangTool::is_alphanumeric(c);
+		flat->lower_of.push_back(VnLangTool::lower(c));
+		uint8_t char_class = VnLangTool::class_of(c);
+		flat->tone_forms_id.push_back(char_class & VnLangTool::TONE_MARK ? VnLangTool::tone_form_of[c] : -1);
+		flat->hat_forms_id.push_back(char_class & VnLangTool::HAT_MARK ? VnLangTool::hat_form_of[c] : -1);
+	}
+	for (const Corpus *corpus : {&queries, &titles})
+	{
+		benchmarks.push_back({"char_class/flat/" + corpus->name,
+			[corpus, flat](BenchState &state)
+			{
+				uint64_t sum = 0;
+				while (state.keep_running())
+				{
+					for (const std::vector< uint32_t > &text : corpus->normalized)
+					{
+						for (uint32_t c : text)
+						{
+							if (c >= (uint32_t) VnLangTool::ALPHANUMERIC_SIZE) continue;
+							sum += flat->in_alphanumeric[c] + flat->lower_of[c] +
+							       ((~flat->tone_forms_id[c]) || (~flat->hat_forms_id[c]));
+						}
+					}
+					do_not_optimize(sum);
+				}
+				state.items_processed = corpus->chars;
+			}});
+		benchmarks.push_back({"char_class/staged/" + corpus->name,
+			[corpus](BenchState &state)
+			{
+				uint64_t sum = 0;
+				while (state.keep_running())
+				{
+					for (const std::vector< uint32_t > &text : corpus->normalized)
+					{
+						for (uint32_t c : text)
+						{
+							sum += VnLangTool::is_alphanumeric(c) + VnLangTool::lower(c) +
+							       VnLangTool::is_tone_hat(c);
+						}
+					}
+					do_not_optimize(sum);
+				}
+				state.items_processed = corpus->chars;
+			}});
+	}
+
+	// longest dictionary prefix at every word start, try_child() and is_ending() only
+	benchmarks.push_back({"multiterm_trie/walk/titles",
+		[&titles, &tokenizer](BenchState &state)
+		{
+			const MultitermDATrie &trie = tokenizer.get_dictionary()->multiterm_trie;
+			long steps = 0;
+			while (state.keep_running())
+			{
+				steps = 0;
+				int endings = 0;
+				for (const std::vector< uint32_t > &text : titles.normalized)
+				{
+					int length = text.size();
+					for (int i = 0; i < length; ++i)
+					{
+						if (!VnLangTool::is_alphanumeric(text[i]) || (i > 0 && VnLangTool::is_alphanumeric(text[i - 1])))
+							continue;
+						int node = 0;
+						for (int j = i; j < length && ~(node = trie.try_child(node, text[j])); ++j)
+						{
+							endings += trie.is_ending(node);
+							steps++;
+						}
+					}
+				}
+				do_not_optimize(endings);
+			}
+			state.items_processed = steps;
+		}});
+
+	// every token candidate starting at every word start, what the DP of run_tokenize() asks for
+	benchmarks.push_back({"get_next_token/titles",
+		[&titles, &tokenizer](BenchState &state)
+		{
+			long calls = 0;
+			while (state.keep_running())
+			{
+				calls = 0;
+				for (const std::vector< uint32_t > &text : titles.normalized)
+				{
+					int length = text.size();
+					for (int i = 0; i < length; ++i)
+					{
+						if (!VnLangTool::is_alphanumeric(text[i]) || (i > 0 && VnLangTool::is_alphanumeric(text[i - 1])))
+							continue;
+						Tokenizer::TemporaryTokenData token_state;
+						Tokenizer::Range token = tokenizer.get_next_token(text.data(), length, i, token_state);
+						calls++;
+						while (~token.right && token.has_more)
+						{
+							token = tokenizer.get_next_token(text.data(), length, token.right, token_state);
+							calls++;
+						}
+						do_not_optimize(token.weight);
+					}
+				}
+			}
+			state.items_processed = calls;
+		}});
+
+	for (size_t length : {16, 64, 256, 1024, 4096})
+	{
+		std::shared_ptr< std::vector< std::vector< uint32_t > > > texts(new std::vector< std::vector< uint32_t > >(
+			make_fixed_length_texts(titles, length, std::max< size_t >(1, 65536 / length))));
+		benchmarks.push_back({"run_tokenize/titles/len:" + std::to_string(length),
+			[texts, &tokenizer](BenchState &state)
+			{
+				TokenizerWorkspace workspace;
+				std::vector< uint32_t > text;
+				std::vector< Token > ranges;
+				std::vector< int > space_positions;
+				long chars = 0;
+				while (state.keep_running())
+				{
+					chars = 0;
+					for (const std::vector< uint32_t > &original : *texts)
+					{
+						text = original; // run_tokenize may rewrite text
+						ranges.clear();
+						space_positions.clear();
+						tokenizer.run_tokenize< Token >(
+							text.data(), text.size(), ranges, space_positions, false, true, true, workspace);
+						do_not_optimize(ranges.data());
+						chars += text.size();
+					}
+				}
+				state.items_processed = chars;
+			}});
+	}
+
+	benchmarks.push_back({"sticky_dp/urls",
+		[&tokenizer, &sticky_runs](BenchState &state)
+		{
+			TokenizerWorkspace workspace;
+			std::vector< int > space_positions;
+			long chars = 0;
+			for (const std::vector< uint32_t > &run : sticky_runs) chars += run.size();
+			while (state.keep_running())
+			{
+				for (const std::vector< uint32_t > &run : sticky_runs)
+				{
+					space_positions.clear();
+					tokenizer.tokenize_pure_sticky_to_syllables(run.data(), run.size(), space_positions, workspace);
+					do_not_optimize(space_positions.data());
+				}
+			}
+			state.items_processed = chars;
+		}});
+
+	// the same with the sticky cache on, every run but the first of each iteration is a hit
+	benchmarks.push_back({"sticky_dp/urls/cached",
+		[&tokenizer, &sticky_runs](BenchState &state)
+		{
+			TokenizerWorkspace workspace;
+			std::vector< int > space_positions;
+			long chars = 0;
+			for (const std::vector< uint32_t > &run : sticky_runs) chars += run.size();
+			tokenizer.set_sticky_cache_capacity(sticky_runs.size());
+			while (state.keep_running())
+			{
+				for (const std::vector< uint32_t > &run : sticky_runs)
+				{
+					space_positions.clear();
+					tokenizer.tokenize_pure_sticky_to_syllables(run.data(), run.size(), space_positions, workspace);
+					do_not_optimize(space_positions.data());
+				}
+			}
+			tokenizer.set_sticky_cache_capacity(0);
+			state.items_processed = chars;
+		}});
+
+	benchmarks.push_back({"segment/url_mode/urls/cached",
+		[&tokenizer, &urls](BenchState &state)
+		{
+			TokenizerWorkspace workspace;
+			std::vector< FullToken > res;
+			tokenizer.set_sticky_cache_capacity(1 << 16);
+			while (state.keep_running())
+			{
+				for (const std::string &line : urls.lines)
+				{
+					tokenizer.segment(line, false, Tokenizer::TOKENIZE_URL, false, res, workspace);
+					do_not_optimize(&res);
+				}
+			}
+			tokenizer.set_sticky_cache_capacity(0);
+			state.items_processed = urls.lines.size();
+			state.bytes_processed = urls.bytes;
+		}});
+
+	// query cache big enough for every line, so only the first iteration misses
+	benchmarks.push_back({"segment/normal/queries/cached",
+		[&tokenizer, &queries](BenchState &state)
+		{
+			TokenizerWorkspace workspace;
+			std::vector< FullToken > res;
+			tokenizer.set_query_cache_capacity(queries.lines.size());
+			while (state.keep_running())
+			{
+				for (const std::string &line : queries.lines)
+				{
+					tokenizer.segment(line, false, Tokenizer::TOKENIZE_NORMAL, false, res, workspace);
+					do_not_optimize(&res);
+				}
+			}
+			tokenizer.set_query_cache_capacity(0);
+			state.items_processed = queries.lines.size();
+			state.bytes_processed = queries.bytes;
+		}});
+
+	add_segment_benchmark(benchmarks, "segment/normal/queries", queries.lines, Tokenizer::TOKENIZE_NORMAL);
+	add_segment_benchmark(benchmarks, "segment/normal/titles", titles.lines, Tokenizer::TOKENIZE_NORMAL);
+	add_segment_benchmark(benchmarks, "segment/normal/urls", urls.lines, Tokenizer::TOKENIZE_NORMAL);
+	add_segment_benchmark(benchmarks, "segment/url_mode/urls", urls.lines, Tokenizer::TOKENIZE_URL);
+	add_segment_benchmark(benchmarks, "segment/host_mode/hosts", hosts, Tokenizer::TOKENIZE_HOST);
+	add_segment_benchmark< SegmentedText >(
+		benchmarks, "segment_offsets/normal/queries", queries.lines, Tokenizer::TOKENIZE_NORMAL);
+	add_segment_benchmark< SegmentedText >(
+		benchmarks, "segment_offsets/normal/titles", titles.lines, Tokenizer::TOKENIZE_NORMAL);
+	add_segment_benchmark< SegmentedText >(
+		benchmarks, "segment_offsets/url_mode/urls", urls.lines, Tokenizer::TOKENIZE_URL);
+
+	for (const Corpus *corpus : {&queries, &titles})
+	{
+		benchmarks.push_back({"tokenize_visitor/normal/" + corpus->name,
+			[corpus, &tokenizer](BenchState &state)
+			{
+				TokenizerWorkspace workspace;
+				uint64_t hash = 0;
+				while (state.keep_running())
+				{
+					for (const std::string &line : corpus->lines)
+					{
+						tokenizer.tokenize(line,
+							false,
+							Tokenizer::TOKENIZE_NORMAL,
+							false,
+							[&hash](int start, int end, int type, int seg_type)
+							{ hash = hash * 31 + start + end + type + seg_type; },
+							workspace);
+					}
+					do_not_optimize(hash);
+				}
+				state.items_processed = corpus->lines.size();
+				state.bytes_processed = corpus->bytes;
+			}});
+	}
+
+	benchmarks.push_back({"segment_batch/titles",
+		[&titles, &tokenizer](BenchState &state)
+		{
+			while (state.keep_running())
+			{
+				std::vector< std::vector< FullToken > > res = tokenizer.segment_batch(titles.lines);
+				do_not_optimize(res.data());
+			}
+			state.items_processed = titles.lines.size();
+			state.bytes_processed = titles.bytes;
+		}});
+
+	std::string dict_path = opts.dict_path;
+	for (bool use_mmap : {false, true})
+	{
+		std::string suffix = use_mmap ? "/mmap" : "/read";
+		add_load_benchmark< MultitermDATrie >(
+			benchmarks, "load/multiterm_trie" + suffix, dict_path + "/" + MULTITERM_DICT_DUMP, use_mmap);
+		add_load_benchmark< SyllableDATrie >(
+			benchmarks, "load/syllable_trie" + suffix, dict_path + "/" + SYLLABLE_DICT_DUMP, use_mmap);
+		add_load_benchmark< CSRMatrix >(
+			benchmarks, "load/nontone_pair_scores" + suffix, dict_path + "/" + NONTONE_PAIR_DICT_DUMP, use_mmap);
+	}
+
+	printf("%-40s %12s %17s %21s\n", "Benchmark", "Iterations", "Time/iter", "Throughput");
+	for (const Benchmark &benchmark : benchmarks)
+	{
+		if (benchmark.name.find(opts.filter) == std::string::npos) continue;
+		run_benchmark(benchmark, opts.min_time);
+	}
+
+	return 0;
+}
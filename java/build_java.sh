@@ -23,7 +23,7 @@ if [ "${OS}" = "darwin" ]; then
 mkdir -p ${BUILD_DIR}/java
 ${JAVA_HOME}/bin/javac -h ${BUILD_DIR}/java -d ${BUILD_DIR}/java ${SOURCE_DIR}/src/java/*.java
 
-g++ -shared -Wall -Werror -std=c++11 -Wno-deprecated -O3 -DNDEBUG -ggdb -fPIC \
+g++ -shared -Wall -Werror -std=c++11 -Wno-deprecated -O3 -DNDEBUG -ggdb -fPIC -pthread \
 	-I ${SOURCE_DIR}/.. \
 	-I ${BUILD_DIR}/auto \
 	-I ${BUILD_DIR}/java \
@@ -0,0 +1,80 @@
+package com.coccoc;
+
+import java.util.ArrayList;
+
+/**
+ * Tokens of all texts of Tokenizer.segmentBatch(), packed into one int[] and one char[].
+ * Tokens are numbered across the whole batch, those of text i are [firstToken(i), firstToken(i + 1)).
+ * See segmentBatchPacked in Tokenizer.cpp for the layout.
+ */
+public final class TokenBatch {
+	private static final int TOKEN_RECORD_INTS = 6;
+
+	private final int[] data;
+	private final char[] texts;
+	private final boolean endsWithFullStop;
+	private final int recordBase;
+
+	TokenBatch(int[] data, char[] texts, boolean endsWithFullStop) {
+		this.data = data;
+		this.texts = texts;
+		this.endsWithFullStop = endsWithFullStop;
+		this.recordBase = data[0] + 2;
+	}
+
+	// Number of texts in the batch
+	public int size() {
+		return data[0];
+	}
+
+	public int firstToken(int text) {
+		return data[1 + text];
+	}
+
+	public int tokenCount(int text) {
+		return data[2 + text] - data[1 + text];
+	}
+
+	public int totalTokenCount() {
+		return data[1 + data[0]];
+	}
+
+	public String getText(int token) {
+		int record = recordBase + token * TOKEN_RECORD_INTS;
+		return new String(texts, data[record], data[record + 1] - data[record]);
+	}
+
+	public int getPos(int token) {
+		return data[recordBase + token * TOKEN_RECORD_INTS + 2];
+	}
+
+	public int getEndPos(int token) {
+		return data[recordBase + token * TOKEN_RECORD_INTS + 3];
+	}
+
+	public Token.Type getType(int token) {
+		return Token.Type.fromInt(data[recordBase + token * TOKEN_RECORD_INTS + 4]);
+	}
+
+	public Token.SegType getSegType(int token) {
+		return Token.SegType.fromInt(data[recordBase + token * TOKEN_RECORD_INTS + 5]);
+	}
+
+	// Tokens of one text, the same as Tokenizer.segment() gives for it
+	public ArrayList<Token> getTokens(int text) {
+		int first = firstToken(text);
+		int end = firstToken(text + 1);
+		ArrayList<Token> res = new ArrayList<>(end - first + 1);
+		for (int token = first; token < end; ++token) {
+			res.add(new Token(getText(token), getType(token), getSegType(token), getPos(token), getEndPos(token)));
+		}
+		if (endsWithFullStop) {
+			res.add(Token.FULL_STOP);
+		}
+		return res;
+	}
+
+	public ArrayList<String> getTokenTexts(int text) {
+		return Token.toStringList(getTokens(text));
+	}
+}
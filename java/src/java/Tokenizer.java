@@ -2,6 +2,8 @@ package com.coccoc;
 
 import java.util.*;
 import java.io.*;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 
 public class Tokenizer {
 	public static final int TOKENIZE_NORMAL = 0;
@@ -9,7 +11,19 @@ public class Tokenizer {
 	public static final int TOKENIZE_URL = 2;
 	public static final String dictPath = "/usr/share/tokenizer/dicts"; // TODO: don't hardcode this value
 
+	// Layout of the buffer returned by segmentBuffer(), see SegmentBuffers in Tokenizer.cpp
+	private static final int HEADER_SIZE = 4 * 2;
+	private static final int TOKEN_RECORD_SIZE = 4 * 6;
+
+	/**
+	 * @deprecated use segment(), it reads the result from one direct buffer instead of through Unsafe
+	 */
+	@Deprecated
 	public native long segmentPointer(String text, boolean for_transforming, int tokenizeOption, boolean keep_puncts);
+	// The buffer wraps native memory of the calling thread, it is only valid until the next call on that thread
+	// and while the thread lives, so it must stay private and never escape segment(), see Tokenizer.cpp
+	private native ByteBuffer segmentBuffer(String text, boolean for_transforming, int tokenizeOption, boolean keep_puncts);
+	private native TokenBatch segmentBatchPacked(String[] texts, boolean for_transforming, int tokenizeOption, boolean keep_puncts, int nThreads);
 	private native void freeMemory(long resPointer);
 	private native int initialize(String dictPath);
 
@@ -41,52 +55,69 @@ public class Tokenizer {
 		if (text == null) {
 			throw new IllegalArgumentException("text is null");
 		}
-		long resPointer = segmentPointer(text, for_transforming, tokenizeOption, keep_puncts);
-
-		ArrayList<Token> res = new ArrayList<>();
-		// Positions from JNI implementation .cpp file
-		long normalizedStringPointer = Unsafe.UNSAFE.getLong(resPointer + 8);
-		int rangesSize = (int) Unsafe.UNSAFE.getLong(resPointer + 8 * 2);
-		long rangesDataPointer = Unsafe.UNSAFE.getLong(resPointer + 8 * 3);
-
-		int spacePositionsSize = (int) Unsafe.UNSAFE.getLong(resPointer + 8 * 5);
-		long spacePositionsDataPointer = Unsafe.UNSAFE.getLong(resPointer + 8 * 6);
-		int[] spacePositions = new int[spacePositionsSize + 1];
-		for (int i = 0; i < spacePositionsSize; ++i) {
-			spacePositions[i] = Unsafe.UNSAFE.getInt(spacePositionsDataPointer + i * 4);
+		// everything is copied out of buffer before returning, it must not be kept or handed out
+		ByteBuffer buffer = segmentBuffer(text, for_transforming, tokenizeOption, keep_puncts);
+		if (buffer == null) {
+			throw new OutOfMemoryError("Cannot read text in Tokenizer");
 		}
-		spacePositions[spacePositionsSize] = -1;
-
-		int TOKEN_SIZE = 4 * 6;
-		for (int i = 0, spacePos = 0; i < rangesSize; ++i) {
-			// Positions of UNSAFE values are calculated from {struct Token} in tokenizer.hpp
-			int startPos = Unsafe.UNSAFE.getInt(rangesDataPointer + i * TOKEN_SIZE);
-			int endPos = Unsafe.UNSAFE.getInt(rangesDataPointer + i * TOKEN_SIZE + 4);
-			int originalStartPos = Unsafe.UNSAFE.getInt(rangesDataPointer + i * TOKEN_SIZE + 8);
-			int originalEndPos = Unsafe.UNSAFE.getInt(rangesDataPointer + i * TOKEN_SIZE + 12);
-			int type = Unsafe.UNSAFE.getInt(rangesDataPointer + i * TOKEN_SIZE + 16);
-			int segType = Unsafe.UNSAFE.getInt(rangesDataPointer + i * TOKEN_SIZE + 20);
-
-			// Build substring from UNSAFE array of codepoints
-			// TODO: Is there a faster way than using StringBuilder?
-			StringBuilder sb = new StringBuilder();
-			for (int j = startPos; j < endPos; ++j) {
-				if (j == spacePositions[spacePos]) {
-					sb.append(for_transforming ? '_' : ' ');
-					spacePos++;
-				}
-				sb.appendCodePoint(Unsafe.UNSAFE.getInt(normalizedStringPointer + j * 4));
-			}
-			res.add(new Token(segType == 1 ? sb.toString().replace(',', '.') : sb.toString(),
+		buffer.order(ByteOrder.nativeOrder());
+		int tokenCount = buffer.getInt(0);
+		int textLength = buffer.getInt(4);
+
+		// Texts of all tokens follow the token records, Strings are built straight from them
+		char[] texts = new char[textLength];
+		buffer.position(HEADER_SIZE + tokenCount * TOKEN_RECORD_SIZE);
+		buffer.asCharBuffer().get(texts);
+
+		ArrayList<Token> res = new ArrayList<>(tokenCount + 1);
+		for (int i = 0; i < tokenCount; ++i) {
+			int record = HEADER_SIZE + i * TOKEN_RECORD_SIZE;
+			int textStart = buffer.getInt(record);
+			int textEnd = buffer.getInt(record + 4);
+			int originalStartPos = buffer.getInt(record + 8);
+			int originalEndPos = buffer.getInt(record + 12);
+			int type = buffer.getInt(record + 16);
+			int segType = buffer.getInt(record + 20);
+			res.add(new Token(new String(texts, textStart, textEnd - textStart),
 					Token.Type.fromInt(type), Token.SegType.fromInt(segType), originalStartPos, originalEndPos));
 		}
 		if (for_transforming && tokenizeOption == TOKENIZE_NORMAL) {
 			res.add(Token.FULL_STOP);
 		}
-		freeMemory(resPointer);
 		return res;
 	}
 
+	/**
+	 * Tokenize all texts in one native call, in parallel on at most nThreads native threads
+	 * (nThreads <= 0 uses all cores).
+	 * The tokens of text i are those segment() gives for it, see TokenBatch.
+	 * All batches run on one process-wide native pool: batches submitted from different Java threads
+	 * are serialized by it and do not run concurrently, a call waits until the previous batches are done.
+	 */
+	public TokenBatch segmentBatch(String[] texts, boolean for_transforming, int tokenizeOption, boolean keep_puncts, int nThreads) {
+		if (texts == null) {
+			throw new IllegalArgumentException("texts is null");
+		}
+		for (String text : texts) {
+			if (text == null) {
+				throw new IllegalArgumentException("text is null");
+			}
+		}
+		TokenBatch res = segmentBatchPacked(texts, for_transforming, tokenizeOption, keep_puncts, nThreads);
+		if (res == null) {
+			throw new OutOfMemoryError("Cannot allocate TokenBatch");
+		}
+		return res;
+	}
+
+	public TokenBatch segmentBatch(String[] texts, int nThreads) {
+		return segmentBatch(texts, false, TOKENIZE_NORMAL, false, nThreads);
+	}
+
+	public TokenBatch segmentBatch(String[] texts) {
+		return segmentBatch(texts, 0);
+	}
+
 	public ArrayList<Token> segment(String text, boolean for_transforming, int tokenizeOption) {
 		return segment(text, for_transforming, tokenizeOption, for_transforming);
 	}
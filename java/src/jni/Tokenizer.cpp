@@ -1,19 +1,239 @@
 #include <jni.h>
 #include <iostream>
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
 #include <vector>
 #include <cassert>
 #include <tokenizer/tokenizer.hpp>
 #include "com_coccoc_Tokenizer.h"
 
+/*
+** tokens of one text in the form both segmentBuffer() and segmentBatchPacked() return them:
+**   records: 6 int32 per token
+**     text_start, text_end (token text in texts, with ',' read as '.' in SKIP_SEG_TYPE tokens)
+**     original_start, original_end (in UTF-16 units of the input string)
+**     type, seg_type
+**   texts: UTF-16 units, texts of all tokens one after another
+** one set is kept per thread (and per text of a batch) and reused by every call
+*/
+struct SegmentBuffers
+{
+	static const int TOKEN_INTS = 6;
+
+	std::vector< Token > ranges;
+	std::vector< int32_t > records;
+	std::vector< uint16_t > texts;
+
+	static SegmentBuffers &of_thread()
+	{
+		static thread_local SegmentBuffers buffers;
+		return buffers;
+	}
+
+	// normalize text into workspace, the same as normalize_to_workspace() does for UTF-8
+	static void normalize(const jchar *text, int length, TokenizerWorkspace &workspace)
+	{
+		workspace.text.clear();
+		workspace.original_pos.clear();
+		workspace.space_positions.clear();
+		Tokenizer::instance().normalize_for_tokenization(text, length, workspace.text, workspace.original_pos, true);
+	}
+
+	// tokenize the text normalized into workspace, records and texts are overwritten
+	void tokenize(bool for_transforming, int tokenize_option, bool keep_puncts, TokenizerWorkspace &workspace)
+	{
+		std::vector< uint32_t > &text = workspace.text;
+		std::vector< int > &original_pos = workspace.original_pos;
+		std::vector< int > &space_positions = workspace.space_positions;
+		ranges.clear();
+		texts.clear();
+
+		Tokenizer::instance().handle_tokenization_request< Token >(
+			text, ranges, space_positions, original_pos, for_transforming, tokenize_option, keep_puncts, workspace);
+		// spaces are already inserted into the normalized text of urls
+		if (tokenize_option == Tokenizer::TOKENIZE_URL) space_positions.clear();
+		space_positions.push_back(-1);
+
+		records.resize(ranges.size() * TOKEN_INTS);
+		int32_t *record = records.data();
+		for (int i = 0, space_it = 0; i < (int) ranges.size(); ++i, record += TOKEN_INTS)
+		{
+			const Token &token = ranges[i];
+			record[0] = texts.size();
+			for (int pos = token.normalized_start; pos < token.normalized_end; ++pos)
+			{
+				if (space_positions[space_it] == pos)
+				{
+					texts.push_back(for_transforming ? '_' : ' ');
+					space_it++;
+				}
+				uint32_t c = text[pos];
+				append_codepoint(token.seg_type == Token::SKIP_SEG_TYPE && c == ',' ? '.' : c);
+			}
+			record[1] = texts.size();
+			record[2] = token.original_start + original_pos[token.normalized_start];
+			record[3] = token.original_end + original_pos[token.normalized_end];
+			record[4] = token.type;
+			record[5] = token.seg_type;
+		}
+	}
+
+	void append_codepoint(uint32_t c)
+	{
+		if (c >= 0x10000)
+		{
+			texts.push_back(0xD800 + ((c - 0x10000) >> 10));
+			texts.push_back(0xDC00 + ((c - 0x10000) & 0x3FF));
+		}
+		else
+		{
+			texts.push_back(c);
+		}
+	}
+};
+
+/*
+** the returned direct ByteBuffer wraps native memory of the calling thread, in native byte order:
+**   int32 token_count
+**   int32 text_length, in UTF-16 units
+**   token_count records of SegmentBuffers
+**   text_length UTF-16 units of SegmentBuffers texts
+** the buffer does not own that memory: it is only valid on the calling thread until its next
+** segmentBuffer() call (which overwrites it or reallocates it) and until the thread exits,
+** so the caller must read everything out before returning and never keep the buffer,
+** Tokenizer.segment() is the only caller and copies the tokens into Java objects right away
+*/
+JNIEXPORT jobject JNICALL Java_com_coccoc_Tokenizer_segmentBuffer(
+	JNIEnv *env, jobject obj, jstring jni_text, jboolean for_transforming, jint tokenize_option, jboolean keep_puncts)
+{
+	static thread_local std::vector< int32_t > result;
+	TokenizerWorkspace &workspace = Tokenizer::thread_workspace();
+	SegmentBuffers &buffers = SegmentBuffers::of_thread();
+
+	int text_length = env->GetStringLength(jni_text);
+	const jchar *jtext = env->GetStringCritical(jni_text, nullptr);
+	if (jtext == nullptr) return nullptr;
+	SegmentBuffers::normalize(jtext, text_length, workspace);
+	env->ReleaseStringCritical(jni_text, jtext);
+
+	buffers.tokenize(for_transforming, tokenize_option, keep_puncts, workspace);
+
+	// texts go right after the records, padded to whole int32s
+	result.resize(2 + buffers.records.size() + (buffers.texts.size() + 1) / 2);
+	result[0] = buffers.ranges.size();
+	result[1] = buffers.texts.size();
+	std::copy(buffers.records.begin(), buffers.records.end(), result.begin() + 2);
+	memcpy(result.data() + 2 + buffers.records.size(), buffers.texts.data(), buffers.texts.size() * sizeof(uint16_t));
+
+	return env->NewDirectByteBuffer(result.data(), result.size() * sizeof(int32_t));
+}
+
+/*
+** tokenize all texts in one call on Tokenizer::batch_pool(), see segment_batch()
+** the texts are copied out of the Java strings first, so no JNI call is made from the workers
+** returns a com.coccoc.TokenBatch over one int[] and one char[]:
+**   int[]: text_count, then text_count + 1 indices of the first token of every text (the last one is
+**          the total token count), then the records of SegmentBuffers of all tokens,
+**          with text_start & text_end into the char[]
+**   char[]: texts of all tokens of all texts
+*/
+JNIEXPORT jobject JNICALL Java_com_coccoc_Tokenizer_segmentBatchPacked(JNIEnv *env,
+	jobject obj,
+	jobjectArray jni_texts,
+	jboolean for_transforming,
+	jint tokenize_option,
+	jboolean keep_puncts,
+	jint n_threads)
+{
+	// buffers of the calling thread, the workers get them by reference
+	static thread_local std::vector< jchar > thread_chars;
+	static thread_local std::vector< size_t > thread_char_offsets;
+	static thread_local std::vector< SegmentBuffers > thread_batch;
+	std::vector< jchar > &chars = thread_chars;
+	std::vector< size_t > &char_offsets = thread_char_offsets;
+	std::vector< SegmentBuffers > &batch = thread_batch;
+
+	int text_count = env->GetArrayLength(jni_texts);
+	chars.clear();
+	char_offsets.assign(1, 0);
+	for (int i = 0; i < text_count; ++i)
+	{
+		jstring jni_text = (jstring) env->GetObjectArrayElement(jni_texts, i);
+		int text_length = jni_text == nullptr ? 0 : env->GetStringLength(jni_text);
+		chars.resize(chars.size() + text_length);
+		if (text_length > 0) env->GetStringRegion(jni_text, 0, text_length, chars.data() + char_offsets.back());
+		char_offsets.push_back(chars.size());
+		env->DeleteLocalRef(jni_text);
+	}
+
+	if ((int) batch.size() < text_count) batch.resize(text_count);
+	Tokenizer::batch_pool().parallel_for(text_count,
+		[&chars, &char_offsets, &batch, for_transforming, tokenize_option, keep_puncts](int, size_t index)
+		{
+			TokenizerWorkspace &workspace = Tokenizer::thread_workspace();
+			SegmentBuffers::normalize(
+				chars.data() + char_offsets[index], char_offsets[index + 1] - char_offsets[index], workspace);
+			batch[index].tokenize(for_transforming, tokenize_option, keep_puncts, workspace);
+		},
+		n_threads);
+
+	size_t token_count = 0, texts_size = 0;
+	for (int i = 0; i < text_count; ++i)
+	{
+		token_count += batch[i].ranges.size();
+		texts_size += batch[i].texts.size();
+	}
+	size_t header_size = 1 + text_count + 1;
+	jintArray jni_data = env->NewIntArray(header_size + token_count * SegmentBuffers::TOKEN_INTS);
+	jcharArray jni_chars = env->NewCharArray(texts_size);
+	if (jni_data == nullptr || jni_chars == nullptr) return nullptr;
+
+	jint *data = (jint *) env->GetPrimitiveArrayCritical(jni_data, nullptr);
+	jchar *texts = (jchar *) env->GetPrimitiveArrayCritical(jni_chars, nullptr);
+	if (data != nullptr && texts != nullptr)
+	{
+		data[0] = text_count;
+		jint *record = data + header_size;
+		int first_token = 0, text_base = 0;
+		for (int i = 0; i < text_count; ++i)
+		{
+			const SegmentBuffers &buffers = batch[i];
+			data[1 + i] = first_token;
+			for (size_t j = 0; j < buffers.records.size(); j += SegmentBuffers::TOKEN_INTS)
+			{
+				record[0] = buffers.records[j] + text_base;
+				record[1] = buffers.records[j + 1] + text_base;
+				std::copy(buffers.records.begin() + j + 2, buffers.records.begin() + j + SegmentBuffers::TOKEN_INTS, record + 2);
+				record += SegmentBuffers::TOKEN_INTS;
+			}
+			std::copy(buffers.texts.begin(), buffers.texts.end(), texts + text_base);
+			first_token += buffers.ranges.size();
+			text_base += buffers.texts.size();
+		}
+		data[1 + text_count] = first_token;
+	}
+	if (texts != nullptr) env->ReleasePrimitiveArrayCritical(jni_chars, texts, 0);
+	if (data != nullptr) env->ReleasePrimitiveArrayCritical(jni_data, data, 0);
+	if (data == nullptr || texts == nullptr) return nullptr;
+
+	jclass batch_class = env->FindClass("com/coccoc/TokenBatch");
+	if (batch_class == nullptr) return nullptr;
+	jmethodID constructor = env->GetMethodID(batch_class, "<init>", "([I[CZ)V");
+	if (constructor == nullptr) return nullptr;
+	jboolean ends_with_full_stop = for_transforming && tokenize_option == Tokenizer::TOKENIZE_NORMAL;
+	return env->NewObject(batch_class, constructor, jni_data, jni_chars, ends_with_full_stop);
+}
+
+// deprecated, see segmentBuffer()
 JNIEXPORT jlong JNICALL Java_com_coccoc_Tokenizer_segmentPointer(
 	JNIEnv *env, jobject obj, jstring jni_text, jboolean for_transforming, jint tokenize_option, jboolean keep_puncts)
 {
 	// Use shared-memory instead of message-passing mechanism to transfer data to Java
 	// return a pointer to an array of pointers
 
-	const jchar *jtext = env->GetStringCritical(jni_text, nullptr);
 	int text_length = env->GetStringLength(jni_text);
+	const jchar *jtext = env->GetStringCritical(jni_text, nullptr);
 	std::vector< uint32_t > *text = new std::vector< uint32_t >();
 	text->reserve(text_length);
 
@@ -9,7 +9,7 @@ cd `dirname $0`
 BUILD_DIR="$1"
 shift
 
-CUSTOM_CFLAGS="-I.. -I${BUILD_DIR}/auto -O2 -march=native -Wno-cpp -Wno-unused-function -std=c++11"
+CUSTOM_CFLAGS="-I.. -I${BUILD_DIR}/auto -O2 -march=native -Wno-cpp -Wno-unused-function -std=c++11 -pthread"
 
 case $OSTYPE in
 	darwin*)
@@ -0,0 +1,73 @@
+# Run with the built CocCocTokenizer module and installed dictionaries:
+#   python3 -m unittest discover -s python/tests
+import os
+import threading
+import unittest
+
+from CocCocTokenizer import PyTokenizer
+
+
+def thread_cpu_ticks():
+    # utime + stime of every thread of this process but the calling one, Linux only
+    ticks = {}
+    own_tid = threading.get_native_id()
+    for tid in os.listdir('/proc/self/task'):
+        if int(tid) == own_tid:
+            continue
+        try:
+            with open('/proc/self/task/%s/stat' % tid) as stat:
+                fields = stat.read().rsplit(')', 1)[1].split()
+        except (IOError, OSError):
+            continue  # the thread has exited
+        ticks[tid] = int(fields[11]) + int(fields[12])
+    return ticks
+
+
+class WordTokenizeBatchTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.tokenizer = PyTokenizer()
+        cls.texts = ['Cộng hòa Xã hội chủ nghĩa Việt Nam, %d người thamgia' % i for i in range(20000)]
+
+    def test_same_tokens_as_word_tokenize(self):
+        texts = self.texts[:100]
+        self.assertEqual(self.tokenizer.word_tokenize_batch(texts, n_threads=2),
+                         [self.tokenizer.word_tokenize(text) for text in texts])
+
+    def test_offsets_match_word_tokenize(self):
+        # multi-byte input: every Vietnamese letter with a tone mark is 2 or 3 UTF-8 bytes, the emoji is 4
+        texts = ['Cộng hòa Xã hội chủ nghĩa Việt Nam, người thamgia',
+                 'Hà Nội https://tuổitrẻ.vn/thời-sự.htm, TP.HCM tăng 12.5% 😀 giávàng hômnay',
+                 'http://dântrí.vn/abc?x=1 và www.zing.vn',
+                 'đường   Nguyễn Huệ...']
+        corpus = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'bench', 'corpus')
+        for name in ('queries', 'titles', 'urls'):
+            with open(os.path.join(corpus, name + '.txt'), encoding='utf-8') as f:
+                texts += [line.rstrip('\n') for line in f]
+        for tokenize_option in (0, 1, 2):
+            batch = self.tokenizer.word_tokenize_batch(texts, tokenize_option, return_offsets=True)
+            self.assertEqual(len(batch), len(texts))
+            for text, offsets in zip(texts, batch):
+                tokens = self.tokenizer.word_tokenize(text, tokenize_option)
+                self.assertEqual(len(offsets), 2 * len(tokens), text)
+                for i, token in enumerate(tokens):
+                    start, end = offsets[2 * i], offsets[2 * i + 1]
+                    self.assertTrue(0 <= start <= end <= len(text), (text, token, start, end))
+                    # token texts join syllables with '_', also where sticky text was split
+                    self.assertEqual(token.replace('_', ''), text[start:end].replace(' ', '').replace('_', ''),
+                                     (text, tokenize_option))
+
+    @unittest.skipUnless(os.path.isdir('/proc/self/task'), 'needs /proc/self/task')
+    def test_single_thread_runs_on_calling_thread(self):
+        # warm up, so the native pool threads exist before measuring
+        self.tokenizer.word_tokenize_batch(self.texts[:100])
+        before = thread_cpu_ticks()
+        for _ in range(3):
+            self.tokenizer.word_tokenize_batch(self.texts, n_threads=1)
+        after = thread_cpu_ticks()
+        busy = [tid for tid in before if tid in after and after[tid] > before[tid]]
+        self.assertEqual(busy, [], 'n_threads=1 but other threads did work')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,58 @@
+#include <atomic>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <tokenizer/tokenizer.hpp>
+#include "check.hpp"
+
+// Tokenizer::batch_pool() is shared by segment_batch(), segment_general_batch()
+// and the batch calls of the Java and Python bindings, which pass their n_threads to it
+
+static void test_n_threads()
+{
+	WorkStealingPool &pool = Tokenizer::batch_pool();
+	for (int n_threads : {1, 2})
+	{
+		std::mutex mutex;
+		std::set< int > workers;
+		pool.parallel_for(1000,
+			[&](int worker, size_t)
+			{
+				std::lock_guard< std::mutex > lock(mutex);
+				workers.insert(worker);
+			},
+			n_threads);
+		CHECK((int) workers.size() <= n_threads);
+	}
+}
+
+// batches submitted from different threads run one after another, never interleaved
+static void test_concurrent_batches()
+{
+	std::atomic< int > running[2];
+	running[0] = running[1] = 0;
+	std::atomic< int > overlaps(0);
+	auto submit = [&](int batch)
+	{
+		Tokenizer::batch_pool().parallel_for(200,
+			[&, batch](int, size_t)
+			{
+				running[batch]++;
+				if (running[1 - batch] != 0) overlaps++;
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+				running[batch]--;
+			});
+	};
+	std::thread first(submit, 0), second(submit, 1);
+	first.join();
+	second.join();
+	CHECK(overlaps == 0);
+}
+
+int main()
+{
+	test_n_threads();
+	test_concurrent_batches();
+	return check_result();
+}
@@ -0,0 +1,26 @@
+#ifndef TESTS_CHECK_HPP
+#define TESTS_CHECK_HPP
+
+#include <iostream>
+
+// minimal checks for the test programs run by ctest, main() returns check_result()
+static int check_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) \
+	{\
+		std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #condition << std::endl;\
+		check_failures++;\
+	}
+
+static int check_result()
+{
+	if (check_failures)
+	{
+		std::cerr << check_failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+#endif // TESTS_CHECK_HPP
@@ -0,0 +1,102 @@
+#include <fstream>
+#include <string>
+#include <vector>
+#include <tokenizer/tokenizer.hpp>
+#include "check.hpp"
+
+// tokenize() streams the same tokens segment() returns, in the same order with the same offsets
+
+struct VisitedToken
+{
+	int original_start, original_end, type, seg_type;
+};
+
+static std::vector< std::string > load_texts(const std::string &file_path)
+{
+	std::vector< std::string > res;
+	std::ifstream f(file_path.c_str());
+	std::string line;
+	while (std::getline(f, line))
+	{
+		res.push_back(line);
+	}
+	return res;
+}
+
+static bool same_tokens(const std::vector< FullToken > &expected, const std::vector< VisitedToken > &visited)
+{
+	if (expected.size() != visited.size()) return false;
+	for (size_t i = 0; i < expected.size(); ++i)
+	{
+		if (expected[i].original_start != visited[i].original_start ||
+			expected[i].original_end != visited[i].original_end || expected[i].type != visited[i].type ||
+			expected[i].seg_type != visited[i].seg_type)
+			return false;
+	}
+	return true;
+}
+
+static void test_same_as_segment(const std::vector< std::string > &texts, int tokenize_option)
+{
+	Tokenizer &tokenizer = Tokenizer::instance();
+	for (bool for_transforming : {false, true})
+	{
+		for (bool keep_puncts : {false, true})
+		{
+			int mismatches = 0;
+			for (const std::string &text : texts)
+			{
+				std::vector< FullToken > expected =
+					tokenizer.segment(text, for_transforming, tokenize_option, keep_puncts);
+				std::vector< VisitedToken > visited;
+				tokenizer.tokenize(text,
+					for_transforming,
+					tokenize_option,
+					keep_puncts,
+					[&visited](int original_start, int original_end, int type, int seg_type)
+					{
+						visited.push_back({original_start, original_end, type, seg_type});
+					});
+				if (!same_tokens(expected, visited))
+				{
+					if (mismatches++ == 0)
+					{
+						std::cerr << "tokenize() differs from segment() on \"" << text << "\", tokenize_option "
+							  << tokenize_option << ", for_transforming " << for_transforming << ", keep_puncts "
+							  << keep_puncts << std::endl;
+					}
+				}
+			}
+			CHECK(mismatches == 0);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " {DICTS_PATH}" << std::endl;
+		return 1;
+	}
+	if (0 > Tokenizer::instance().initialize(argv[1])) return 1;
+
+	std::vector< std::string > texts = {"",
+		" ",
+		"Xin chào, thế giới!!  Hà Nội   năm 2024...",
+		"TP.HCM: giá vàng 9.999 đồng/chỉ (tăng 1,5%)",
+		"muốnxemphim trên youtube.com/watch?v=abc hoặc https://vnexpress.net/the-gioi",
+		"email: ai@coccoc.com; số 0912-345-678",
+		"hoahậuviệtnam2018 vietnamairlines.com.vn"};
+	for (const char *name : {"queries", "titles", "urls"})
+	{
+		std::vector< std::string > corpus = load_texts(std::string(TEST_CORPUS_PATH) + "/" + name + ".txt");
+		CHECK(!corpus.empty());
+		texts.insert(texts.end(), corpus.begin(), corpus.end());
+	}
+
+	test_same_as_segment(texts, Tokenizer::TOKENIZE_NORMAL);
+	test_same_as_segment(texts, Tokenizer::TOKENIZE_URL);
+	test_same_as_segment(texts, Tokenizer::TOKENIZE_HOST);
+	return check_result();
+}
@@ -0,0 +1,89 @@
+#include <atomic>
+#include <set>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+#include <tokenizer/auxiliary/work_stealing_pool.hpp>
+#include "check.hpp"
+
+// run a loop of count indices with max_workers, return the distinct workers which ran fn
+static std::set< int > run_loop(WorkStealingPool &pool, size_t count, int max_workers)
+{
+	std::mutex mutex;
+	std::set< int > workers;
+	std::vector< std::atomic< int > > calls(count);
+	for (std::atomic< int > &c : calls)
+	{
+		c = 0;
+	}
+	pool.parallel_for(count,
+		[&](int worker, size_t index)
+		{
+			calls[index]++;
+			std::lock_guard< std::mutex > lock(mutex);
+			workers.insert(worker);
+		},
+		max_workers);
+	for (size_t i = 0; i < count; ++i)
+	{
+		CHECK(calls[i] == 1);
+	}
+	return workers;
+}
+
+static void test_max_workers()
+{
+	WorkStealingPool pool(8);
+	for (int max_workers : {1, 2, 3, 7})
+	{
+		// several rounds, so that idle threads have every chance to wake up and steal
+		for (int round = 0; round < 50; ++round)
+		{
+			std::set< int > workers = run_loop(pool, 1000, max_workers);
+			CHECK((int) workers.size() <= max_workers);
+			CHECK(*workers.rbegin() < max_workers);
+		}
+	}
+	// max_workers <= 0 or above the pool size uses the whole pool
+	CHECK((int) run_loop(pool, 1000, 0).size() <= pool.size());
+	CHECK((int) run_loop(pool, 1000, 100).size() <= pool.size());
+	// a single worker is the calling thread
+	CHECK(run_loop(pool, 1000, 1) == std::set< int >({0}));
+}
+
+// parallel_for() from inside a task of the same pool runs inline instead of waiting for the outer loop
+static void test_nested()
+{
+	WorkStealingPool pool(4);
+	std::atomic< int > inner_calls(0), other_workers(0), caught(0);
+	pool.parallel_for(16,
+		[&](int outer_worker, size_t)
+		{
+			pool.parallel_for(10,
+				[&](int worker, size_t)
+				{
+					inner_calls++;
+					if (worker != outer_worker) other_workers++;
+				});
+			try
+			{
+				pool.parallel_for(3, [](int, size_t) { throw std::runtime_error("nested"); });
+			}
+			catch (const std::runtime_error &)
+			{
+				caught++;
+			}
+		});
+	CHECK(inner_calls == 160);
+	CHECK(other_workers == 0);
+	CHECK(caught == 16);
+	// the pool is still usable by a top-level loop afterwards
+	CHECK((int) run_loop(pool, 1000, 0).size() <= pool.size());
+}
+
+int main()
+{
+	test_max_workers();
+	test_nested();
+	return check_result();
+}
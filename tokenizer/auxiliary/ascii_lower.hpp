@@ -0,0 +1,99 @@
+#ifndef ASCII_LOWER_HPP
+#define ASCII_LOWER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+** Bulk conversion of ASCII text into lowercase codepoints, used by the tokenizer to skip UTF-8
+** decoding and per-codepoint table lookups on the ASCII runs that make up most urls and queries
+** Blocks of 32 (AVX2) or 16 (SSE2) bytes are checked and converted at once, the rest byte by byte
+*/
+namespace AsciiLower
+{
+inline uint32_t lower(unsigned char c)
+{
+	return (unsigned char) (c - 'A') < 26 ? c + ('a' - 'A') : c;
+}
+
+/*
+** convert the leading ASCII bytes of src[0..size) to lowercase codepoints into text and
+** their byte positions (position of src[0] is position) into original_pos
+** stop at the first non-ASCII byte, return the number of bytes converted
+*/
+inline size_t convert_prefix(const char *src, size_t size, uint32_t *text, int *original_pos, int position)
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	const __m256i before_upper = _mm256_set1_epi8('A' - 1);
+	const __m256i after_upper = _mm256_set1_epi8('Z' + 1);
+	const __m256i case_bit = _mm256_set1_epi8('a' - 'A');
+	const __m256i step = _mm256_set1_epi32(8);
+	__m256i positions = _mm256_add_epi32(_mm256_set1_epi32(position), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	for (; i + 32 <= size; i += 32)
+	{
+		__m256i bytes = _mm256_loadu_si256((const __m256i *) (src + i));
+		if (_mm256_movemask_epi8(bytes) != 0) break;
+		// all bytes are below 0x80 here, so signed comparisons are fine
+		__m256i is_upper =
+			_mm256_and_si256(_mm256_cmpgt_epi8(bytes, before_upper), _mm256_cmpgt_epi8(after_upper, bytes));
+		bytes = _mm256_add_epi8(bytes, _mm256_and_si256(is_upper, case_bit));
+
+		__m128i halves[2] = {_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1)};
+		for (int h = 0; h < 2; ++h)
+		{
+			for (int q = 0; q < 2; ++q)
+			{
+				__m128i eight = q == 0 ? halves[h] : _mm_srli_si128(halves[h], 8);
+				size_t offset = i + h * 16 + q * 8;
+				_mm256_storeu_si256((__m256i *) (text + offset), _mm256_cvtepu8_epi32(eight));
+				_mm256_storeu_si256((__m256i *) (original_pos + offset), positions);
+				positions = _mm256_add_epi32(positions, step);
+			}
+		}
+	}
+#elif defined(__SSE2__)
+	const __m128i before_upper = _mm_set1_epi8('A' - 1);
+	const __m128i after_upper = _mm_set1_epi8('Z' + 1);
+	const __m128i case_bit = _mm_set1_epi8('a' - 'A');
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i step = _mm_set1_epi32(4);
+	__m128i positions = _mm_add_epi32(_mm_set1_epi32(position), _mm_setr_epi32(0, 1, 2, 3));
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i *) (src + i));
+		if (_mm_movemask_epi8(bytes) != 0) break;
+		// all bytes are below 0x80 here, so signed comparisons are fine
+		__m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, before_upper), _mm_cmpgt_epi8(after_upper, bytes));
+		bytes = _mm_add_epi8(bytes, _mm_and_si128(is_upper, case_bit));
+
+		__m128i words[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+		for (int w = 0; w < 2; ++w)
+		{
+			size_t offset = i + w * 8;
+			_mm_storeu_si128((__m128i *) (text + offset), _mm_unpacklo_epi16(words[w], zero));
+			_mm_storeu_si128((__m128i *) (text + offset + 4), _mm_unpackhi_epi16(words[w], zero));
+			_mm_storeu_si128((__m128i *) (original_pos + offset), positions);
+			positions = _mm_add_epi32(positions, step);
+			_mm_storeu_si128((__m128i *) (original_pos + offset + 4), positions);
+			positions = _mm_add_epi32(positions, step);
+		}
+	}
+#endif
+	for (; i < size; ++i)
+	{
+		unsigned char c = src[i];
+		if (c >= 0x80) break;
+		text[i] = lower(c);
+		original_pos[i] = position + i;
+	}
+	return i;
+}
+} // namespace AsciiLower
+
+#endif // ASCII_LOWER_HPP
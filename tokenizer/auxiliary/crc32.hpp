@@ -0,0 +1,55 @@
+#ifndef CRC32_HPP
+#define CRC32_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+** CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320), same values as zlib's crc32()
+** crc32_update() can be chained: crc32_update(crc32_update(0, a, n), b, m) == crc of a followed by b
+*/
+namespace CRC32
+{
+struct Table
+{
+	uint32_t values[256];
+
+	Table()
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+			{
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			values[i] = c;
+		}
+	}
+};
+
+inline const uint32_t *table()
+{
+	static const Table crc_table; // thread-safe initialization since C++11
+	return crc_table.values;
+}
+
+inline uint32_t crc32_update(uint32_t crc, const void *data, size_t size)
+{
+	const uint32_t *t = table();
+	const unsigned char *p = (const unsigned char *) data;
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+inline uint32_t crc32(const void *data, size_t size)
+{
+	return crc32_update(0, data, size);
+}
+}
+
+#endif // CRC32_HPP
@@ -0,0 +1,259 @@
+#ifndef CSR_MATRIX_HPP
+#define CSR_MATRIX_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include "mapped_file.hpp"
+
+/*
+** Layout of a dump file:
+** header, row_offsets (uint32_t[rows + 1]), columns (int32_t[nnz]), values (float[nnz])
+** Everything is 4-byte aligned, so a dump can be used right from a read-only mapping
+*/
+struct CSRMatrixFileHeader
+{
+	static const uint32_t MAGIC = 0x4D525343; // "CSRM"
+	static const uint32_t VERSION = 1;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t rows;
+	uint32_t nnz;
+
+	size_t data_size() const
+	{
+		return (rows + 1) * sizeof(uint32_t) + nnz * (sizeof(int32_t) + sizeof(float));
+	}
+};
+
+/*
+** Sparse 2D array of floats in compressed-sparse-row layout
+** Row i is stored in [row_offsets[i], row_offsets[i + 1]) of columns & values, columns sorted ascending
+*/
+struct CSRMatrix
+{
+	// Owned storage, filled by append_row() or read_from_file()
+	std::vector< uint32_t > row_offset_storage;
+	std::vector< int32_t > column_storage;
+	std::vector< float > value_storage;
+
+	// Lookups go through these views only, same as in DATrie
+	const uint32_t *row_offsets;
+	const int32_t *columns;
+	const float *values;
+	uint32_t rows;
+	uint32_t nnz;
+	std::shared_ptr< MappedFile > mapped_file;
+
+	CSRMatrix() : row_offsets(nullptr), columns(nullptr), values(nullptr), rows(0), nnz(0)
+	{
+	}
+
+	CSRMatrix(const CSRMatrix &other)
+	{
+		*this = other;
+	}
+
+	CSRMatrix &operator=(const CSRMatrix &other)
+	{
+		row_offset_storage = other.row_offset_storage;
+		column_storage = other.column_storage;
+		value_storage = other.value_storage;
+		rows = other.rows;
+		nnz = other.nnz;
+		mapped_file = other.mapped_file;
+		if (mapped_file)
+		{
+			row_offsets = other.row_offsets;
+			columns = other.columns;
+			values = other.values;
+		}
+		else
+		{
+			bind_owned_storage();
+		}
+		return *this;
+	}
+
+	void bind_owned_storage()
+	{
+		if (row_offset_storage.empty()) row_offset_storage.push_back(0);
+		row_offsets = row_offset_storage.data();
+		columns = column_storage.data();
+		values = value_storage.data();
+		rows = row_offset_storage.size() - 1;
+		nnz = column_storage.size();
+	}
+
+	inline bool empty() const
+	{
+		return rows == 0;
+	}
+
+	/*
+	** return pointer to the value at (row, column), nullptr if it is zero
+	** branch-light binary search, the loop body compiles to a conditional move
+	*/
+	inline const float *find(int row, int column) const
+	{
+		const int32_t *first = columns + row_offsets[row];
+		uint32_t count = row_offsets[row + 1] - row_offsets[row];
+		if (count == 0) return nullptr;
+		while (count > 1)
+		{
+			uint32_t half = count >> 1;
+			first = first[half] <= column ? first + half : first;
+			count -= half;
+		}
+		return *first == column ? values + (first - columns) : nullptr;
+	}
+
+	// entries are (column, value), on duplicated columns the last value is kept
+	void append_row(std::vector< std::pair< int, float > > &entries)
+	{
+		std::stable_sort(entries.begin(),
+			entries.end(),
+			[](const std::pair< int, float > &x, const std::pair< int, float > &y)
+			{
+				return x.first < y.first;
+			});
+		if (row_offset_storage.empty()) row_offset_storage.push_back(0);
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			if (i + 1 < entries.size() && entries[i + 1].first == entries[i].first) continue;
+			column_storage.push_back(entries[i].first);
+			value_storage.push_back(entries[i].second);
+		}
+		row_offset_storage.push_back(column_storage.size());
+		mapped_file.reset();
+		bind_owned_storage();
+	}
+
+	int dump_to_file(const std::string &file_path)
+	{
+		FILE *out_file = fopen(file_path.c_str(), "wb");
+		if (out_file == nullptr)
+		{
+			std::cerr << "Cannot open file for writing " << file_path << std::endl;
+			return -1;
+		}
+
+		CSRMatrixFileHeader header;
+		header.magic = CSRMatrixFileHeader::MAGIC;
+		header.version = CSRMatrixFileHeader::VERSION;
+		header.rows = rows;
+		header.nnz = nnz;
+
+		bool ok = fwrite(&header, sizeof(header), 1, out_file) == 1 &&
+			  fwrite(row_offsets, sizeof(uint32_t), rows + 1, out_file) == rows + 1 &&
+			  fwrite(columns, sizeof(int32_t), nnz, out_file) == nnz &&
+			  fwrite(values, sizeof(float), nnz, out_file) == nnz;
+
+		fclose(out_file);
+		if (!ok)
+		{
+			std::cerr << "Cannot write full matrix to " << file_path << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+
+	static bool check_header(const CSRMatrixFileHeader &header)
+	{
+		if (header.magic != CSRMatrixFileHeader::MAGIC || header.version != CSRMatrixFileHeader::VERSION)
+		{
+			std::cerr << "Unsupported matrix dump format, dictionaries must be recompiled" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	int read_from_file(const std::string &file_path)
+	{
+		FILE *in_file = fopen(file_path.c_str(), "rb");
+		if (in_file == nullptr)
+		{
+			std::cerr << "Cannot open file for reading " << file_path << std::endl;
+			return -1;
+		}
+
+#define RETURN_ERROR \
+	{\
+		fclose(in_file);\
+		std::cerr << "Cannot read full matrix!" << std::endl;\
+		return -1;\
+	}
+
+		CSRMatrixFileHeader header;
+		if (fread(&header, sizeof(header), 1, in_file) != 1) RETURN_ERROR
+		if (!check_header(header))
+		{
+			fclose(in_file);
+			return -1;
+		}
+
+		row_offset_storage.resize(header.rows + 1);
+		column_storage.resize(header.nnz);
+		value_storage.resize(header.nnz);
+		if (fread(row_offset_storage.data(), sizeof(uint32_t), header.rows + 1, in_file) != header.rows + 1)
+			RETURN_ERROR
+		if (fread(column_storage.data(), sizeof(int32_t), header.nnz, in_file) != header.nnz) RETURN_ERROR
+		if (fread(value_storage.data(), sizeof(float), header.nnz, in_file) != header.nnz) RETURN_ERROR
+
+		fclose(in_file);
+		mapped_file.reset();
+		bind_owned_storage();
+		return 0;
+
+#undef RETURN_ERROR
+	}
+
+	/*
+	** Use a dump which is already in memory without copying it
+	** data must stay valid and unchanged for the lifetime of the matrix
+	*/
+	int attach(const char *data, size_t size)
+	{
+		CSRMatrixFileHeader header;
+		if (size < sizeof(header))
+		{
+			std::cerr << "Cannot read full matrix!" << std::endl;
+			return -1;
+		}
+		memcpy(&header, data, sizeof(header));
+		if (!check_header(header)) return -1;
+		if (sizeof(header) + header.data_size() > size)
+		{
+			std::cerr << "Cannot read full matrix!" << std::endl;
+			return -1;
+		}
+
+		row_offset_storage.clear();
+		row_offset_storage.shrink_to_fit();
+		column_storage.clear();
+		column_storage.shrink_to_fit();
+		value_storage.clear();
+		value_storage.shrink_to_fit();
+		rows = header.rows;
+		nnz = header.nnz;
+		row_offsets = (const uint32_t *) (data + sizeof(header));
+		columns = (const int32_t *) (row_offsets + rows + 1);
+		values = (const float *) (columns + nnz);
+		return 0;
+	}
+
+	int map_from_file(const std::string &file_path)
+	{
+		std::shared_ptr< MappedFile > file(new MappedFile());
+		if (0 > file->map(file_path)) return -1;
+		if (0 > attach(file->data, file->size)) return -1;
+		mapped_file = file;
+		return 0;
+	}
+};
+
+#endif // CSR_MATRIX_HPP
@@ -0,0 +1,208 @@
+#ifndef DICT_BUNDLE_HPP
+#define DICT_BUNDLE_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <iostream>
+#include "mapped_file.hpp"
+#include "crc32.hpp"
+
+/*
+** Layout of a bundle file:
+** header, section table (DictBundleSection[section_count]), then the sections, each 8-byte aligned
+** header.table_crc covers the header (with table_crc = 0) and the section table, so it also protects
+** the per-section CRCs, offsets and sizes, each section.crc covers the bytes of that section
+** All integers are stored in the byte order of the machine which compiled the bundle, byte_order tells
+** a reader on a machine of the other byte order to reject it
+*/
+struct DictBundleHeader
+{
+	static const uint32_t MAGIC = 0x4C444E42; // "BNDL"
+	static const uint32_t VERSION = 1;
+	static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t section_count;
+	uint64_t file_size;
+	uint32_t table_crc;
+	uint32_t reserved;
+};
+
+struct DictBundleSection
+{
+	uint32_t id;
+	uint32_t crc;
+	uint64_t offset; // from the beginning of the file
+	uint64_t size;
+};
+
+/*
+** One file holding every dictionary the tokenizer needs, used through a single read-only mapping
+*/
+struct DictBundle
+{
+	enum SectionId
+	{
+		MULTITERM_TRIE = 1,
+		SYLLABLE_TRIE = 2,
+		NONTONE_PAIR_SCORES = 3,
+		// VnLangTool sources, stored as the original text files
+		VN_ALPHABETIC = 4,
+		VN_NUMERIC = 5,
+		VN_D_AND_GI = 6,
+		VN_I_AND_Y = 7
+	};
+
+	static const size_t ALIGNMENT = 8;
+
+	std::shared_ptr< MappedFile > mapped_file;
+	std::vector< DictBundleSection > sections;
+
+	static size_t align(size_t offset)
+	{
+		return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	}
+
+	static uint32_t table_crc(DictBundleHeader header, const DictBundleSection *sections)
+	{
+		header.table_crc = 0;
+		uint32_t crc = CRC32::crc32(&header, sizeof(header));
+		return CRC32::crc32_update(crc, sections, header.section_count * sizeof(DictBundleSection));
+	}
+
+	// sections are (id, content) pairs, written in the given order
+	static int write_to_file(const std::string &file_path, const std::vector< std::pair< uint32_t, std::string > > &contents)
+	{
+		DictBundleHeader header;
+		header.magic = DictBundleHeader::MAGIC;
+		header.version = DictBundleHeader::VERSION;
+		header.byte_order = DictBundleHeader::BYTE_ORDER_MARK;
+		header.section_count = contents.size();
+		header.reserved = 0;
+
+		std::vector< DictBundleSection > table(contents.size());
+		size_t offset = align(sizeof(header) + table.size() * sizeof(DictBundleSection));
+		for (size_t i = 0; i < contents.size(); ++i)
+		{
+			table[i].id = contents[i].first;
+			table[i].crc = CRC32::crc32(contents[i].second.data(), contents[i].second.size());
+			table[i].offset = offset;
+			table[i].size = contents[i].second.size();
+			offset = align(offset + table[i].size);
+		}
+		header.file_size = offset;
+		header.table_crc = table_crc(header, table.data());
+
+		FILE *out_file = fopen(file_path.c_str(), "wb");
+		if (out_file == nullptr)
+		{
+			std::cerr << "Cannot open file for writing " << file_path << std::endl;
+			return -1;
+		}
+		static const char padding[ALIGNMENT] = {0};
+		size_t written = sizeof(header) + table.size() * sizeof(DictBundleSection);
+		bool ok = fwrite(&header, sizeof(header), 1, out_file) == 1 &&
+			  fwrite(table.data(), sizeof(DictBundleSection), table.size(), out_file) == table.size();
+		for (size_t i = 0; ok && i < contents.size(); ++i)
+		{
+			ok = fwrite(padding, 1, table[i].offset - written, out_file) == table[i].offset - written &&
+			     fwrite(contents[i].second.data(), 1, table[i].size, out_file) == table[i].size;
+			written = table[i].offset + table[i].size;
+		}
+		ok = ok && fwrite(padding, 1, header.file_size - written, out_file) == header.file_size - written;
+
+		fclose(out_file);
+		if (!ok)
+		{
+			std::cerr << "Cannot write full bundle to " << file_path << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+
+	/*
+	** map a bundle and check its header and section table
+	** verify_sections = true also checks the CRC of every section, which reads the whole file
+	*/
+	int map_from_file(const std::string &file_path, bool verify_sections)
+	{
+		std::shared_ptr< MappedFile > file(new MappedFile());
+		if (0 > file->map(file_path)) return -1;
+
+		DictBundleHeader header;
+		if (file->size < sizeof(header))
+		{
+			std::cerr << "Truncated dictionary bundle " << file_path << std::endl;
+			return -1;
+		}
+		memcpy(&header, file->data, sizeof(header));
+		if (header.magic != DictBundleHeader::MAGIC || header.version != DictBundleHeader::VERSION ||
+			header.byte_order != DictBundleHeader::BYTE_ORDER_MARK)
+		{
+			std::cerr << "Unsupported dictionary bundle format, dictionaries must be recompiled" << std::endl;
+			return -1;
+		}
+		if (header.file_size != file->size ||
+			sizeof(header) + header.section_count * sizeof(DictBundleSection) > file->size)
+		{
+			std::cerr << "Truncated dictionary bundle " << file_path << std::endl;
+			return -1;
+		}
+
+		std::vector< DictBundleSection > table(header.section_count);
+		memcpy(table.data(), file->data + sizeof(header), table.size() * sizeof(DictBundleSection));
+		if (table_crc(header, table.data()) != header.table_crc)
+		{
+			std::cerr << "Corrupted dictionary bundle " << file_path << std::endl;
+			return -1;
+		}
+		for (const DictBundleSection &section : table)
+		{
+			if (section.offset % ALIGNMENT != 0 || section.offset > file->size ||
+				section.size > file->size - section.offset)
+			{
+				std::cerr << "Corrupted dictionary bundle " << file_path << std::endl;
+				return -1;
+			}
+			if (verify_sections && CRC32::crc32(file->data + section.offset, section.size) != section.crc)
+			{
+				std::cerr << "Corrupted section " << section.id << " in dictionary bundle " << file_path
+					  << std::endl;
+				return -1;
+			}
+		}
+
+		mapped_file = file;
+		sections.swap(table);
+		return 0;
+	}
+
+	// return false if there's no such section
+	bool find_section(uint32_t id, const char *&data, size_t &size) const
+	{
+		for (const DictBundleSection &section : sections)
+		{
+			if (section.id == id)
+			{
+				data = mapped_file->data + section.offset;
+				size = section.size;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// section content as a string, empty if there's no such section
+	std::string section_string(uint32_t id) const
+	{
+		const char *data;
+		size_t size;
+		return find_section(id, data, size) ? std::string(data, size) : std::string();
+	}
+};
+
+#endif // DICT_BUNDLE_HPP
@@ -0,0 +1,151 @@
+#ifndef LRU_CACHE_HPP
+#define LRU_CACHE_HPP
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include <unordered_map>
+
+/*
+** Bounded least-recently-used cache safe to use from many threads
+** Keys are spread over shards by hash, each shard has its own mutex and LRU list and holds
+** capacity / shard_count entries, so threads looking up different keys rarely wait for each other
+** Hit and miss counts are kept across all shards
+*/
+template < class Key, class Value, class Hash = std::hash< Key > >
+class ShardedLruCache
+{
+public:
+	explicit ShardedLruCache(size_t capacity, int shard_count = 16) : hit_count(0), miss_count(0)
+	{
+		if (shard_count < 1) shard_count = 1;
+		if (capacity < (size_t) shard_count) shard_count = capacity > 0 ? capacity : 1;
+		for (int i = 0; i < shard_count; ++i)
+		{
+			shards.push_back(std::unique_ptr< Shard >(new Shard()));
+			// split capacity so that the shards hold exactly capacity entries in total
+			shards.back()->capacity = capacity / shard_count + ((size_t) i < capacity % shard_count ? 1 : 0);
+		}
+	}
+
+	ShardedLruCache(const ShardedLruCache &) = delete;
+	ShardedLruCache &operator=(const ShardedLruCache &) = delete;
+
+	// copy the value of key into value and mark it as recently used, return false if it's not cached
+	bool find(const Key &key, Value &value)
+	{
+		Shard &shard = shard_of(key);
+		std::lock_guard< std::mutex > lock(shard.mutex);
+		auto it = shard.index.find(key);
+		if (it == shard.index.end())
+		{
+			miss_count.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+		value = it->second->second;
+		hit_count.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// add or replace the value of key, the least recently used entry of its shard is evicted when it is full
+	void insert(const Key &key, const Value &value)
+	{
+		Shard &shard = shard_of(key);
+		std::lock_guard< std::mutex > lock(shard.mutex);
+		if (shard.capacity == 0) return;
+		auto it = shard.index.find(key);
+		if (it != shard.index.end())
+		{
+			it->second->second = value;
+			shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+			return;
+		}
+		if (shard.entries.size() >= shard.capacity)
+		{
+			shard.index.erase(shard.entries.back().first);
+			shard.entries.pop_back();
+		}
+		shard.entries.push_front(std::make_pair(key, value));
+		shard.index[key] = shard.entries.begin();
+	}
+
+	void clear()
+	{
+		for (std::unique_ptr< Shard > &shard : shards)
+		{
+			std::lock_guard< std::mutex > lock(shard->mutex);
+			shard->index.clear();
+			shard->entries.clear();
+		}
+		hit_count = 0;
+		miss_count = 0;
+	}
+
+	size_t size()
+	{
+		size_t res = 0;
+		for (std::unique_ptr< Shard > &shard : shards)
+		{
+			std::lock_guard< std::mutex > lock(shard->mutex);
+			res += shard->entries.size();
+		}
+		return res;
+	}
+
+	size_t capacity() const
+	{
+		size_t res = 0;
+		for (const std::unique_ptr< Shard > &shard : shards)
+		{
+			res += shard->capacity;
+		}
+		return res;
+	}
+
+	inline uint64_t hits() const
+	{
+		return hit_count.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t misses() const
+	{
+		return miss_count.load(std::memory_order_relaxed);
+	}
+
+	// share of lookups that were hits, 0 before the first one
+	double hit_rate() const
+	{
+		uint64_t hit = hits(), lookups = hit + misses();
+		return lookups > 0 ? (double) hit / lookups : 0;
+	}
+
+private:
+	typedef std::list< std::pair< Key, Value > > entry_list_t;
+
+	struct Shard
+	{
+		std::mutex mutex;
+		size_t capacity;
+		entry_list_t entries; // most recently used first
+		std::unordered_map< Key, typename entry_list_t::iterator, Hash > index;
+	};
+
+	std::vector< std::unique_ptr< Shard > > shards;
+	Hash hash;
+	std::atomic< uint64_t > hit_count;
+	std::atomic< uint64_t > miss_count;
+
+	inline Shard &shard_of(const Key &key)
+	{
+		// the map of the shard uses the low bits of the same hash, so pick the shard by the high bits
+		uint64_t h = (uint64_t) hash(key) * 0x9E3779B97F4A7C15ULL;
+		return *shards[(h >> 32) % shards.size()];
+	}
+};
+
+#endif // LRU_CACHE_HPP
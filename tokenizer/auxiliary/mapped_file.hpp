@@ -0,0 +1,72 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+** Read-only memory mapping of a whole file
+** Pages come straight from the page cache, so all processes mapping the same
+** dictionary dump share one physical copy of it
+*/
+struct MappedFile
+{
+	const char *data;
+	size_t size;
+
+	MappedFile() : data(nullptr), size(0)
+	{
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	~MappedFile()
+	{
+		unmap();
+	}
+
+	int map(const std::string &file_path)
+	{
+		unmap();
+		int fd = open(file_path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			std::cerr << "Cannot open file for mapping " << file_path << std::endl;
+			return -1;
+		}
+		struct stat st;
+		if (fstat(fd, &st) < 0 || st.st_size <= 0)
+		{
+			close(fd);
+			std::cerr << "Cannot map empty or unreadable file " << file_path << std::endl;
+			return -1;
+		}
+		void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd); // the mapping keeps its own reference to the file
+		if (addr == MAP_FAILED)
+		{
+			std::cerr << "Cannot map file " << file_path << std::endl;
+			return -1;
+		}
+		data = (const char *) addr;
+		size = st.st_size;
+		return 0;
+	}
+
+	void unmap()
+	{
+		if (data != nullptr)
+		{
+			munmap((void *) data, size);
+			data = nullptr;
+			size = 0;
+		}
+	}
+};
+
+#endif // MAPPED_FILE_HPP
@@ -4,28 +4,140 @@
 #include <vector>
 #include <set>
 #include <string>
-#include "../tsl/robin_set.h"
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include "../mapped_file.hpp"
+#include "da_trie_node.hpp"
+
+/*
+** Layout of a dump file:
+** header, char_map (int32_t[char_map_size]), padding up to 8 bytes,
+** cells (DATrieCell[pool_size]), tail (DATrieTailEntry[tail_size]), pool (Node[pool_size + tail_size])
+** All arrays are stored ready to use, so a dump can be used right from a read-only mapping
+** Dumps of any other version must be recompiled
+*/
+struct DATrieFileHeader
+{
+	static const uint32_t MAGIC = 0x52544144; // "DATR"
+	static const uint32_t VERSION = 4;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t node_size; // sizeof(Node), guards against reading a dump built for another node layout
+	int32_t alphabet_size;
+	uint64_t char_map_size;
+	uint64_t pool_size; // number of cells
+	uint64_t tail_size;
+
+	size_t pool_offset() const
+	{
+		size_t offset = sizeof(DATrieFileHeader) + char_map_size * sizeof(int32_t);
+		return (offset + 7) & ~(size_t) 7;
+	}
+
+	size_t tail_offset() const
+	{
+		return pool_offset() + pool_size * sizeof(DATrieCell);
+	}
+
+	size_t nodes_offset() const
+	{
+		return tail_offset() + tail_size * sizeof(DATrieTailEntry);
+	}
+
+	size_t end_offset() const
+	{
+		return nodes_offset() + (pool_size + tail_size) * node_size;
+	}
+};
 
 template < class HashNode, class Node >
 struct DATrie
 {
-	template < typename T >
-	using fast_hash_set_t = tsl::robin_set< T >;
-
+	// Owned storage, filled when the trie is built or read with read_from_file()
+	// node i is cell_pool[i] for i < cell_pool.size(), tail_pool[i - cell_pool.size()] above that,
+	// pool[i] is its payload either way
+	std::vector< DATrieCell > cell_pool;
+	std::vector< DATrieTailEntry > tail_pool;
 	std::vector< Node > pool;
 	std::vector< int > char_map;
 	int alphabet_size;
 
+	// Lookups go through these views only, they point either to the vectors above
+	// or into a read-only mapping of a dump file (see map_from_file())
+	const DATrieCell *cells;
+	size_t cell_count;
+	const DATrieTailEntry *tail;
+	size_t tail_count;
+	const Node *nodes;
+	size_t node_count;
+	const int *char_codes;
+	size_t char_code_count;
+	std::shared_ptr< MappedFile > mapped_file;
+
 	DATrie()
+	    : alphabet_size(0),
+	      cells(nullptr),
+	      cell_count(0),
+	      tail(nullptr),
+	      tail_count(0),
+	      nodes(nullptr),
+	      node_count(0),
+	      char_codes(nullptr),
+	      char_code_count(0)
+	{
+	}
+
+	DATrie(const DATrie &other)
+	{
+		*this = other;
+	}
+
+	DATrie &operator=(const DATrie &other)
+	{
+		cell_pool = other.cell_pool;
+		tail_pool = other.tail_pool;
+		pool = other.pool;
+		char_map = other.char_map;
+		alphabet_size = other.alphabet_size;
+		mapped_file = other.mapped_file;
+		if (other.nodes != other.pool.data())
+		{
+			cells = other.cells;
+			cell_count = other.cell_count;
+			tail = other.tail;
+			tail_count = other.tail_count;
+			nodes = other.nodes;
+			node_count = other.node_count;
+			char_codes = other.char_codes;
+			char_code_count = other.char_code_count;
+		}
+		else
+		{
+			bind_owned_storage();
+		}
+		return *this;
+	}
+
+	void bind_owned_storage()
 	{
+		cells = cell_pool.data();
+		cell_count = cell_pool.size();
+		tail = tail_pool.data();
+		tail_count = tail_pool.size();
+		nodes = pool.data();
+		node_count = pool.size();
+		char_codes = char_map.data();
+		char_code_count = char_map.size();
 	}
 
-	DATrie(const std::string &file_path)
+	DATrie(const std::string &file_path) : DATrie()
 	{
 		read_from_file(file_path);
 	}
 
-	DATrie(HashTrie< HashNode > &hash_trie)
+	DATrie(HashTrie< HashNode > &hash_trie) : DATrie()
 	{
 		build_from_hash_trie(hash_trie);
 	}
@@ -52,151 +164,189 @@ struct DATrie
 		}
 	}
 
+	/*
+	** children of a node with a single path below it go to the tail, the others to the double array
+	** children in trie_info always come after their parent, so the nodes are placed in one pass
+	*/
 	void build_trie(const std::vector< HashNode > &trie_info)
 	{
-		std::vector< int > positions = construct(trie_info);
+		std::vector< char > single_path = find_single_paths(trie_info);
+		std::vector< int > positions = construct(trie_info, single_path);
 		int last_position = *std::max_element(positions.begin(), positions.end());
-		pool.assign(last_position + alphabet_size, Node());
-
-		pool[0].base = 1;
-		pool[0].assign_data(trie_info[0]);
+		int cell_pool_size = std::max(last_position + alphabet_size, 1);
+		size_t tail_size = 0;
+		for (int i = 0; i < (int) trie_info.size(); ++i)
+		{
+			if (single_path[i]) tail_size += trie_info[i].children.size();
+		}
+		cell_pool.assign(cell_pool_size, DATrieCell());
+		tail_pool.clear();
+		tail_pool.reserve(tail_size);
+		pool.assign(cell_pool_size + tail_size, Node());
 
-		std::vector< int > mapping(trie_info.size());
+		std::vector< int > mapping(trie_info.size(), 0);
 		for (int i = 0; i < (int) trie_info.size(); ++i)
 		{
+			int u = mapping[i];
+			if (u >= cell_pool_size) continue; // placed with the rest of its path
+			pool[u].assign_data(trie_info[i]);
+			uint32_t flags = Node::flags_of(trie_info[i]);
+
+			if (single_path[i] && !trie_info[i].children.empty())
+			{
+				cell_pool[u].base = tail_pool.size() | DATrieCell::TAIL | flags;
+				for (int v = i; !trie_info[v].children.empty();)
+				{
+					auto it = *trie_info[v].children.begin();
+					v = it.second;
+					mapping[v] = cell_pool_size + tail_pool.size();
+					pool[mapping[v]].assign_data(trie_info[v]);
+
+					DATrieTailEntry entry;
+					entry.label = char_map[it.first] | Node::flags_of(trie_info[v]) |
+						      (trie_info[v].children.empty() ? DATrieTailEntry::LAST : 0);
+					tail_pool.push_back(entry);
+				}
+				continue;
+			}
+
+			cell_pool[u].base = positions[i] | flags;
 			for (auto it : trie_info[i].children)
 			{
-				int index = pool[mapping[i]].base + char_map[it.first];
+				int index = positions[i] + char_map[it.first];
 				mapping[it.second] = index;
-				pool[index].base = positions[it.second];
-				pool[index].parent = mapping[i];
-				pool[index].assign_data(trie_info[it.second]);
+				cell_pool[index].check = u;
 			}
 		}
+		mapped_file.reset();
+		bind_owned_storage();
 	}
 
-	std::vector< int > construct(const std::vector< HashNode > &trie_info)
+	// res[i] is true when no node in the subtree of i (i included) has more than one child
+	static std::vector< char > find_single_paths(const std::vector< HashNode > &trie_info)
 	{
-		auto extract_mask = [this](const HashNode &node) -> std::vector< int >
-		{
-			std::vector< int > res;
-			res.reserve(node.children.size());
-			for (auto it : node.children)
-			{
-				res.push_back(char_map[it.first]);
-			}
-			return res;
-		};
-
-		// pos[i] = set of positions having ith-bit OFF
-		std::vector< fast_hash_set_t< int > > pos(alphabet_size);
-
-		std::vector< int > res(trie_info.size());
-		std::vector< bool > state;
-		state.assign(alphabet_size + 2, 0);
-		int cur_end = 2;
-		for (int i = 0; i < alphabet_size; ++i)
+		std::vector< char > res(trie_info.size(), 0);
+		for (int i = (int) trie_info.size() - 1; i >= 0; --i)
 		{
-			pos[i].insert(1);
+			const auto &children = trie_info[i].children;
+			res[i] = children.empty() || (children.size() == 1 && res[children.begin()->second]);
 		}
+		return res;
+	}
+
+	/*
+	** find the base of every node with children in the double array (0 for the others),
+	** so that base + char_map[c] of all children are distinct
+	** classic double-array construction: free positions form a doubly linked list and every node takes
+	** the first base (first-fit) at which all its children land on free positions
+	** position 0 is the root, it is never free and serves as the head of the list
+	*/
+	std::vector< int > construct(const std::vector< HashNode > &trie_info, const std::vector< char > &single_path)
+	{
+		std::vector< int > res(trie_info.size(), 0);
+		std::vector< int > next_free(1, 0), prev_free(1, 0);
+		std::vector< char > used(1, 1);
 
-		auto grab_status_reverse = [&state, this](int from)
+		// append positions [used.size(), new_size) to the end of the free list
+		auto grow = [&next_free, &prev_free, &used](size_t new_size)
 		{
-			std::vector< int > off_bit_positions;
-			for (int i = alphabet_size - 1; i >= 0; --i)
+			for (int p = used.size(); p < (int) new_size; ++p)
 			{
-				if (state[from + i] == 0)
-				{
-					off_bit_positions.push_back(i);
-				}
+				used.push_back(0);
+				next_free.push_back(0);
+				prev_free.push_back(prev_free[0]);
+				next_free[prev_free[0]] = p;
+				prev_free[0] = p;
 			}
-			return off_bit_positions;
 		};
+		grow(alphabet_size + 2);
 
+		std::vector< int > mask;
 		for (int i = 0; i < (int) trie_info.size(); ++i)
 		{
-			if (trie_info[i].children.empty())
+			if (single_path[i]) continue;
+
+			mask.clear();
+			for (auto it : trie_info[i].children)
 			{
-				res[i] = 0;
-				continue;
+				mask.push_back(char_map[it.first]);
 			}
+			std::sort(mask.begin(), mask.end());
 
-			std::vector< int > mask = extract_mask(trie_info[i]);
-			sort(mask.begin(),
-				mask.end(),
-				[&pos](const int x, const int y)
-				{
-					return pos[x].size() < pos[y].size();
-				});
-
-			int found_pos = -1;
-			for (int p : pos[mask[0]])
+			int base = 0;
+			for (int p = next_free[0];; p = next_free[p])
 			{
+				if (p == 0)
+				{
+					// no free position left, the first new one is the next to try
+					p = used.size();
+					grow(used.size() + alphabet_size);
+				}
+				base = p - mask[0];
+				if (base < 1) continue;
+				if (base + mask.back() >= (int) used.size()) grow(base + mask.back() + 1);
 				bool good = true;
 				for (int j = 1; j < (int) mask.size(); ++j)
 				{
-					if (pos[mask[j]].find(p) == pos[mask[j]].end())
+					if (used[base + mask[j]])
 					{
 						good = false;
 						break;
 					}
 				}
-				if (good)
-				{
-					found_pos = p; // Yay!
-					break;
-				}
+				if (good) break; // Yay!
 			}
 
-			if (found_pos == -1)
+			res[i] = base;
+			for (int offset : mask)
 			{
-				found_pos = cur_end;
+				int p = base + offset;
+				used[p] = 1;
+				next_free[prev_free[p]] = next_free[p];
+				prev_free[next_free[p]] = prev_free[p];
 			}
+		}
 
-			res[i] = found_pos;
-
-			int affected_end = found_pos + (*std::max_element(mask.begin(), mask.end()));
-			if (cur_end <= affected_end)
-			{
-				std::vector< int > off_bit_positions = grab_status_reverse(cur_end);
-				while (cur_end <= affected_end)
-				{
-					if (!off_bit_positions.empty() && off_bit_positions.back() < cur_end)
-						off_bit_positions.pop_back();
-					for (int off_bit_pos : off_bit_positions)
-					{
-						pos[off_bit_pos].insert(cur_end);
-					}
-					cur_end++;
-					state.push_back(0);
-				}
-			}
+		return res;
+	}
 
-			for (int offset : mask)
+	/*
+	** return the child of u by c, -1 if there is no such child
+	** doesn't touch any state, so a loaded trie can be shared between threads
+	*/
+	inline int try_child(const int u, const uint32_t c) const
+	{
+		if (c >= char_code_count || char_codes[c] < 0) return -1;
+		const uint32_t code = char_codes[c];
+		size_t position;
+		if ((size_t) u < cell_count)
+		{
+			const uint32_t base = cells[u].base;
+			if (!(base & DATrieCell::TAIL))
 			{
-				int cur_pos = found_pos + offset;
-				for (int affected_pos = cur_pos;
-					affected_pos > cur_pos - alphabet_size && affected_pos >= 0;
-					--affected_pos)
-				{
-					pos[cur_pos - affected_pos].erase(affected_pos);
-				}
-				state[cur_pos] = 1;
+				int v = (base & DATrieCell::BASE_MASK) + code;
+				return cells[v].check == u ? v : -1;
 			}
+			position = base & DATrieCell::BASE_MASK;
 		}
-
-		return res;
+		else
+		{
+			// the only child of a tail node is the next entry
+			position = u - cell_count;
+			if (tail[position++].label & DATrieTailEntry::LAST) return -1;
+		}
+		return (tail[position].label & DATrieTailEntry::CODE_MASK) == code ? (int) (cell_count + position) : -1;
 	}
 
-	inline int get_child(const int u, const uint32_t c)
+	// flag is a DATrieCell flag, as set by Node::flags_of()
+	inline bool has_flag(const int u, const uint32_t flag) const
 	{
-		return pool[u].base + char_map[c];
+		return ((size_t) u < cell_count ? cells[u].base : tail[u - cell_count].label) & flag;
 	}
 
-	int cache_node;
-	inline bool has_child(const int u, const uint32_t c)
+	inline bool has_child(const int u, const uint32_t c) const
 	{
-		return c < char_map.size() && (~char_map[c]) && pool[cache_node = get_child(u, c)].parent == u;
+		return ~try_child(u, c);
 	}
 
 	int dump_to_file(const std::string &file_path)
@@ -208,23 +358,45 @@ struct DATrie
 			return -1;
 		}
 
-		fwrite(&alphabet_size, sizeof(alphabet_size), 1, out_file);
-		for (uint32_t i = 0; i < char_map.size(); ++i)
-		{
-			if (~char_map[i])
-			{
-				fwrite(&i, sizeof(i), 1, out_file);
-			}
-		}
-
-		size_t pool_size = pool.size();
-		fwrite(&pool_size, sizeof(pool_size), 1, out_file);
-		fwrite(pool.data(), sizeof(Node), pool_size, out_file);
+		DATrieFileHeader header;
+		header.magic = DATrieFileHeader::MAGIC;
+		header.version = DATrieFileHeader::VERSION;
+		header.node_size = sizeof(Node);
+		header.alphabet_size = alphabet_size;
+		header.char_map_size = char_code_count;
+		header.pool_size = cell_count;
+		header.tail_size = tail_count;
+
+		static const char padding[8] = {0};
+		size_t padding_size = header.pool_offset() - sizeof(header) - header.char_map_size * sizeof(int32_t);
+
+		bool ok = fwrite(&header, sizeof(header), 1, out_file) == 1 &&
+			  fwrite(char_codes, sizeof(int32_t), char_code_count, out_file) == char_code_count &&
+			  fwrite(padding, 1, padding_size, out_file) == padding_size &&
+			  fwrite(cells, sizeof(DATrieCell), cell_count, out_file) == cell_count &&
+			  fwrite(tail, sizeof(DATrieTailEntry), tail_count, out_file) == tail_count &&
+			  fwrite(nodes, sizeof(Node), node_count, out_file) == node_count;
 
 		fclose(out_file);
+		if (!ok)
+		{
+			std::cerr << "Cannot write full trie information to " << file_path << std::endl;
+			return -1;
+		}
 		return 0;
 	}
 
+	static bool check_header(const DATrieFileHeader &header)
+	{
+		if (header.magic != DATrieFileHeader::MAGIC || header.version != DATrieFileHeader::VERSION ||
+			header.node_size != sizeof(Node))
+		{
+			std::cerr << "Unsupported trie dump format, dictionaries must be recompiled" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
 	int read_from_file(const std::string &file_path)
 	{
 		FILE *in_file = fopen(file_path.c_str(), "rb");
@@ -241,22 +413,84 @@ struct DATrie
 		return -1;\
 	}
 
-		if (fread(&alphabet_size, sizeof(alphabet_size), 1, in_file) != 1) RETURN_ERROR
-		std::vector< uint32_t > char_set(alphabet_size);
+		DATrieFileHeader header;
+		if (fread(&header, sizeof(header), 1, in_file) != 1) RETURN_ERROR
+		if (!check_header(header))
+		{
+			fclose(in_file);
+			return -1;
+		}
 
-		if (fread(char_set.data(), sizeof(uint32_t), alphabet_size, in_file) != (size_t) alphabet_size) RETURN_ERROR
-		build_char_map(std::set< uint32_t >(char_set.begin(), char_set.end()));
+		alphabet_size = header.alphabet_size;
+		char_map.resize(header.char_map_size);
+		if (fread(char_map.data(), sizeof(int32_t), char_map.size(), in_file) != char_map.size()) RETURN_ERROR
 
-		size_t pool_size = 0;
-		if (fread(&pool_size, sizeof(pool_size), 1, in_file) != 1) RETURN_ERROR
-		pool.resize(pool_size);
-		if (fread(pool.data(), sizeof(Node), pool_size, in_file) != pool_size) RETURN_ERROR
+		if (fseeko(in_file, header.pool_offset(), SEEK_SET) != 0) RETURN_ERROR
+		cell_pool.resize(header.pool_size);
+		tail_pool.resize(header.tail_size);
+		pool.resize(header.pool_size + header.tail_size);
+		if (fread(cell_pool.data(), sizeof(DATrieCell), cell_pool.size(), in_file) != cell_pool.size()) RETURN_ERROR
+		if (fread(tail_pool.data(), sizeof(DATrieTailEntry), tail_pool.size(), in_file) != tail_pool.size())
+			RETURN_ERROR
+		if (fread(pool.data(), sizeof(Node), pool.size(), in_file) != pool.size()) RETURN_ERROR
 
 		fclose(in_file);
+		mapped_file.reset();
+		bind_owned_storage();
 		return 0;
 
 #undef RETURN_ERROR
 	}
+
+	/*
+	** Use a dump which is already in memory without copying it
+	** data must stay valid and unchanged for the lifetime of the trie
+	*/
+	int attach(const char *data, size_t size)
+	{
+		DATrieFileHeader header;
+		if (size < sizeof(header))
+		{
+			std::cerr << "Cannot read full trie information!" << std::endl;
+			return -1;
+		}
+		memcpy(&header, data, sizeof(header));
+		if (!check_header(header)) return -1;
+		if (header.end_offset() > size)
+		{
+			std::cerr << "Cannot read full trie information!" << std::endl;
+			return -1;
+		}
+
+		alphabet_size = header.alphabet_size;
+		cell_pool.clear();
+		cell_pool.shrink_to_fit();
+		tail_pool.clear();
+		tail_pool.shrink_to_fit();
+		pool.clear();
+		pool.shrink_to_fit();
+		char_map.clear();
+		char_map.shrink_to_fit();
+		char_codes = (const int *) (data + sizeof(header));
+		char_code_count = header.char_map_size;
+		cells = (const DATrieCell *) (data + header.pool_offset());
+		cell_count = header.pool_size;
+		tail = (const DATrieTailEntry *) (data + header.tail_offset());
+		tail_count = header.tail_size;
+		nodes = (const Node *) (data + header.nodes_offset());
+		node_count = header.pool_size + header.tail_size;
+		return 0;
+	}
+
+	// Read-only mode: lookups run directly over a shared mapping of the dump file
+	int map_from_file(const std::string &file_path)
+	{
+		std::shared_ptr< MappedFile > file(new MappedFile());
+		if (0 > file->map(file_path)) return -1;
+		if (0 > attach(file->data, file->size)) return -1;
+		mapped_file = file;
+		return 0;
+	}
 };
 
 #endif // DA_TRIE_HPP
@@ -1,18 +1,61 @@
 #ifndef DA_TRIE_NODE_HPP
 #define DA_TRIE_NODE_HPP
 
-struct DATrieNode
+#include <cstdint>
+
+/*
+** Transition part of a DATrie node, the only one the trie walk reads
+** Cells are kept in their own array, 8 per cache line, apart from the payload of the nodes
+** The two high bits of base are flags of the node, so e.g. is_ending can be checked
+** on the node just reached without touching its payload
+** With TAIL set, the children of the node form a single path stored in the tail (see DATrieTailEntry),
+** base is then the position of the first of them there
+*/
+struct DATrieCell
 {
-	int base;
-	int parent;
+	static const uint32_t FLAG_0 = 1u << 31;
+	static const uint32_t FLAG_1 = 1u << 30;
+	static const uint32_t FLAGS = FLAG_0 | FLAG_1;
+	static const uint32_t TAIL = 1u << 29;
+	static const uint32_t BASE_MASK = ~(FLAGS | TAIL);
+
+	uint32_t base; // flags | TAIL | first position of the children
+	int32_t check; // parent, -1 for free cells
 
-	DATrieNode()
+	DATrieCell()
 	{
 		base = 0;
-		parent = -1;
+		check = -1;
 	}
+};
+
+/*
+** Node of a single-path suffix (MP-trie tail), stored in the tail array instead of a cell
+** Suffixes without branches make up most of the nodes of a dictionary trie, in the tail each one
+** takes 4 bytes and no slot of the double array, and the next node of the path is the next entry
+** label is the symbol code of the transition into the node, with the flags of DATrieCell,
+** LAST marks the leaf ending the suffix
+*/
+struct DATrieTailEntry
+{
+	static const uint32_t LAST = 1u << 29;
+	static const uint32_t CODE_MASK = ~(DATrieCell::FLAGS | LAST);
 
-	// derived classes must implement assign_data(const HashTrieNode &node);
+	uint32_t label; // flags | LAST | symbol code
+};
+
+/*
+** Payload of a DATrie node, what derived classes add is stored apart from the cells
+** derived classes must implement assign_data(const HashTrieNode &node);
+** and may hide flags_of() to set DATrieCell flags of the node
+*/
+struct DATrieNode
+{
+	template < class HashNode >
+	static uint32_t flags_of(const HashNode &)
+	{
+		return 0;
+	}
 };
 
-#endif // DA_TRIE_NODE_HPP
\ No newline at end of file
+#endif // DA_TRIE_NODE_HPP
@@ -21,19 +21,19 @@ struct MultitermDATrie : DATrie< MultitermHashTrieNode, MultitermDATrieNode >
 	{
 	}
 
-	inline float get_weight(const int u)
+	inline float get_weight(const int u) const
 	{
-		return pool[u].weight;
+		return nodes[u].weight;
 	}
 
-	inline bool is_ending(const int u)
+	inline bool is_ending(const int u) const
 	{
-		return pool[u].is_ending;
+		return has_flag(u, MultitermDATrieNode::ENDING);
 	}
 
-	inline bool is_special(const int u)
+	inline bool is_special(const int u) const
 	{
-		return pool[u].is_special;
+		return has_flag(u, MultitermDATrieNode::SPECIAL);
 	}
 };
 
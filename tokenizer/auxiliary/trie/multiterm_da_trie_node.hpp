@@ -5,23 +5,25 @@
 
 struct MultitermDATrieNode : DATrieNode
 {
+	static const uint32_t ENDING = DATrieCell::FLAG_0;
+	static const uint32_t SPECIAL = DATrieCell::FLAG_1;
+
 	float weight;
-	bool is_ending;
-	bool is_special;
 
 	MultitermDATrieNode() : DATrieNode()
 	{
 		this->weight = 0;
-		this->is_ending = false;
-		this->is_special = false;
 	}
 
 	void assign_data(const MultitermHashTrieNode &node)
 	{
 		this->weight = node.weight;
-		this->is_ending = node.frequency != -1;
-		this->is_special = node.is_special;
+	}
+
+	static uint32_t flags_of(const MultitermHashTrieNode &node)
+	{
+		return (node.frequency != -1 ? ENDING : 0) | (node.is_special ? SPECIAL : 0);
 	}
 };
 
-#endif // MULTITERM_DA_TRIE_NODE_HPP
\ No newline at end of file
+#endif // MULTITERM_DA_TRIE_NODE_HPP
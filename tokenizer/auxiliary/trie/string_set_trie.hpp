@@ -10,16 +10,15 @@
 
 struct StringSetTrieNode : DATrieNode
 {
-	bool is_ending;
+	static const uint32_t ENDING = DATrieCell::FLAG_0;
 
-	StringSetTrieNode() : DATrieNode()
+	void assign_data(const HashTrieNode &)
 	{
-		this->is_ending = false;
 	}
 
-	void assign_data(const HashTrieNode &node)
+	static uint32_t flags_of(const HashTrieNode &node)
 	{
-		this->is_ending = node.frequency != -1;
+		return node.frequency != -1 ? ENDING : 0;
 	}
 };
 
@@ -35,15 +34,15 @@ struct StringSetTrie : DATrie< HashTrieNode, StringSetTrieNode >
 		build_from_hash_trie(initial_hash_trie);
 	}
 
-	bool contains(const uint32_t *text, int length)
+	bool contains(const uint32_t *text, int length) const
 	{
 		int node = 0;
 		for (int i = 0; i < length; ++i)
 		{
-			if (!has_child(node, text[i])) return false;
-			node = cache_node;
+			node = try_child(node, text[i]);
+			if (node == -1) return false;
 		}
-		return pool[node].is_ending;
+		return has_flag(node, StringSetTrieNode::ENDING);
 	}
 };
 
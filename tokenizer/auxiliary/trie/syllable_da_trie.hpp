@@ -29,12 +29,11 @@ struct SyllableDATrie : DATrie< SyllableHashTrieNode, SyllableDATrieNode >
 		int length = 0;
 		while (it != end_it)
 		{
-			uint32_t codepoint = *it;
-			if (!has_child(cur_node, codepoint))
+			cur_node = try_child(cur_node, *it);
+			if (cur_node == -1)
 			{
 				return 0;
 			}
-			cur_node = get_child(cur_node, codepoint);
 			it++;
 			length++;
 		}
@@ -42,14 +41,14 @@ struct SyllableDATrie : DATrie< SyllableHashTrieNode, SyllableDATrieNode >
 		return length;
 	}
 
-	inline float get_weight(const int u)
+	inline float get_weight(const int u) const
 	{
-		return pool[u].weight;
+		return nodes[u].weight;
 	}
 
-	inline int get_index(const int u)
+	inline int get_index(const int u) const
 	{
-		return pool[u].index;
+		return nodes[u].index;
 	}
 };
 
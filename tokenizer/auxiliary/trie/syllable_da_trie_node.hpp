@@ -22,4 +22,4 @@ struct SyllableDATrieNode : DATrieNode
 	}
 };
 
-#endif // SYLLABLE_DA_TRIE_NODE_HPP
\ No newline at end of file
+#endif // SYLLABLE_DA_TRIE_NODE_HPP
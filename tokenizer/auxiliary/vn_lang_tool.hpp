@@ -5,19 +5,25 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <bitset>
+#include <algorithm>
 #include <string>
 #include <memory>
+#include <iterator>
 #include <cstring>
 #include <unordered_map>
 #include <chrono>
 #include <atomic>
+#include <mutex>
+#include <functional>
 
 #include <tokenizer/config.h>
 #include "utf8.h"
+#include "ascii_lower.hpp"
+#include "crc32.hpp"
 
 #define VN_LANG_TOOL_INIT_OK 0
 #define VN_LANG_TOOL_DICT_NOT_FOUND -1
+#define VN_LANG_TOOL_TABLES_MISMATCH -2
 
 /*
 ** Port of VnLangTool.java in C++
@@ -70,7 +76,6 @@ std::string tone_forms[24] = {"aáàảãạ",
 	"UÚÙỦŨỤ",
 	"ƯỨỪỬỮỰ",
 	"YÝỲỶỸỴ"};
-std::vector< uint32_t > tone_forms_UTF[24];
 
 std::string hat_forms[24] = {
 	"aâăa",
@@ -98,28 +103,181 @@ std::string hat_forms[24] = {
 	"ũũũữ",
 	"ụụụự",
 };
-std::vector< uint32_t > hat_forms_UTF[24];
 
-int tone_forms_id[ALPHANUMERIC_SIZE];
-int hat_forms_id[ALPHANUMERIC_SIZE];
-int tone_id[ALPHANUMERIC_SIZE];
-int hat_id[ALPHANUMERIC_SIZE];
+/*
+** Flat tables of ALPHANUMERIC_SIZE entries, only used while init() builds the staged tables below
+** and released afterwards
+*/
+std::vector< int > tone_forms_id;
+std::vector< int > hat_forms_id;
+std::vector< int > tone_id;
+std::vector< int > hat_id;
+
+std::vector< uint32_t > lower_of;
+std::vector< uint32_t > upper_of;
+std::vector< uint32_t > root_of;
+std::vector< uint32_t > lower_root_of;
+
+std::vector< bool > in_alphabet;
+std::vector< bool > in_numeric;
+std::vector< bool > in_alphanumeric;
+
+const int STAGE_BLOCK_BITS = 8;
+const int STAGE_BLOCK_SIZE = 1 << STAGE_BLOCK_BITS;
+const int STAGE_PAGE_COUNT = ALPHANUMERIC_SIZE >> STAGE_BLOCK_BITS;
+
+/*
+** Lookup table over codepoints below ALPHANUMERIC_SIZE in two stages: c is entry c % STAGE_BLOCK_SIZE
+** of block page_index[c / STAGE_BLOCK_SIZE], equal blocks are stored once
+** Real text only touches a handful of blocks, so lookups stay in L1 instead of being scattered
+** over 64K-entry arrays
+** Both arrays are either precompiled (see vn_lang_tool_tables.h) or owned by a StagedTableStorage
+*/
+template < class T >
+struct StagedTable
+{
+	static const T ZERO_BLOCK[STAGE_BLOCK_SIZE];
+
+	const uint16_t *page_index;
+	const T *blocks;
+
+	// c must be less than ALPHANUMERIC_SIZE
+	inline T operator[](uint32_t c) const
+	{
+		return blocks[((uint32_t) page_index[c >> STAGE_BLOCK_BITS] << STAGE_BLOCK_BITS) |
+			      (c & (STAGE_BLOCK_SIZE - 1))];
+	}
+
+	int block_count() const
+	{
+		return *std::max_element(page_index, page_index + STAGE_PAGE_COUNT) + 1;
+	}
+
+	size_t memory_size() const
+	{
+		return STAGE_PAGE_COUNT * sizeof(uint16_t) + block_count() * STAGE_BLOCK_SIZE * sizeof(T);
+	}
+};
+
+template < class T >
+const T StagedTable< T >::ZERO_BLOCK[STAGE_BLOCK_SIZE] = {};
 
-uint32_t lower_of[ALPHANUMERIC_SIZE];
-uint32_t upper_of[ALPHANUMERIC_SIZE];
-uint32_t root_of[ALPHANUMERIC_SIZE];
-uint32_t lower_root_of[ALPHANUMERIC_SIZE];
+const uint16_t ZERO_PAGE_INDEX[STAGE_PAGE_COUNT] = {};
+
+// StagedTable built at runtime
+template < class T >
+struct StagedTableStorage
+{
+	uint16_t page_index[STAGE_PAGE_COUNT];
+	std::vector< T > blocks;
+
+	// flat has ALPHANUMERIC_SIZE entries
+	StagedTable< T > build(const std::vector< T > &flat)
+	{
+		blocks.clear();
+		for (int page = 0; page < STAGE_PAGE_COUNT; ++page)
+		{
+			typename std::vector< T >::const_iterator block = flat.begin() + page * STAGE_BLOCK_SIZE;
+			int block_count = blocks.size() / STAGE_BLOCK_SIZE;
+			int found = 0;
+			while (found < block_count &&
+				!std::equal(block, block + STAGE_BLOCK_SIZE, blocks.begin() + found * STAGE_BLOCK_SIZE))
+			{
+				found++;
+			}
+			if (found == block_count) blocks.insert(blocks.end(), block, block + STAGE_BLOCK_SIZE);
+			page_index[page] = found;
+		}
+		StagedTable< T > table = {page_index, blocks.data()};
+		return table;
+	}
+};
+
+// flags of char_class
+const uint8_t ALPHABETIC = 1;
+const uint8_t NUMERIC = 2;
+const uint8_t ALPHANUMERIC = 4;
+const uint8_t TONE_BASE = 8;  // a tone mark can be merged into it
+const uint8_t HAT_BASE = 16;  // a hat mark can be merged into it
+const uint8_t TONE_MARK = 32; // combining tone mark
+const uint8_t HAT_MARK = 64;  // combining hat mark
+
+const int TONE_FORM_COUNT = 6;
+const int HAT_FORM_COUNT = 4;
+
+struct PrecompiledTransformation
+{
+	const char *from;
+	size_t from_size;
+	const char *to;
+	size_t to_size;
+};
 
 /*
-** When used as a bool array, bitset provides no speed improvements
-** But it consumes less memory
+** Unless VN_LANG_TOOL_NO_PRECOMPILED is defined, the tables below start out as the tables built from
+** dicts/vn_lang_tool at build time, in read-only data and without any work at startup
+** init() then only rebuilds them when the given files differ from the ones compiled in
 */
-// bool in_alphabet[ALPHANUMERIC_SIZE];
-// bool in_numeric[ALPHANUMERIC_SIZE];
-// bool in_alphanumeric[ALPHANUMERIC_SIZE];
-std::bitset< ALPHANUMERIC_SIZE > in_alphabet;
-std::bitset< ALPHANUMERIC_SIZE > in_numeric;
-std::bitset< ALPHANUMERIC_SIZE > in_alphanumeric;
+#ifndef VN_LANG_TOOL_NO_PRECOMPILED
+#include <tokenizer/vn_lang_tool_tables.h>
+#define VN_LANG_TOOL_STAGED_TABLE(T, name) StagedTable< T > name = {Precompiled::name##_pages, Precompiled::name##_blocks}
+#else
+#define VN_LANG_TOOL_STAGED_TABLE(T, name) StagedTable< T > name = {ZERO_PAGE_INDEX, StagedTable< T >::ZERO_BLOCK}
+#endif
+
+// all character classes in one byte, so that hot loops need one lookup per codepoint
+VN_LANG_TOOL_STAGED_TABLE(uint8_t, char_class);
+// case and root mappings store differences to the codepoint, so that identity blocks are all equal
+VN_LANG_TOOL_STAGED_TABLE(int32_t, lower_delta);
+VN_LANG_TOOL_STAGED_TABLE(int32_t, upper_delta);
+VN_LANG_TOOL_STAGED_TABLE(int32_t, root_delta);
+VN_LANG_TOOL_STAGED_TABLE(int32_t, lower_root_delta);
+// -1 for none, only valid where char_class has the matching flag
+VN_LANG_TOOL_STAGED_TABLE(int8_t, tone_id_of);
+VN_LANG_TOOL_STAGED_TABLE(int8_t, hat_id_of);
+VN_LANG_TOOL_STAGED_TABLE(int8_t, tone_form_of);
+VN_LANG_TOOL_STAGED_TABLE(int8_t, hat_form_of);
+
+#undef VN_LANG_TOOL_STAGED_TABLE
+
+// tables built at runtime
+struct RuntimeTables
+{
+	StagedTableStorage< uint8_t > char_class;
+	StagedTableStorage< int32_t > lower_delta;
+	StagedTableStorage< int32_t > upper_delta;
+	StagedTableStorage< int32_t > root_delta;
+	StagedTableStorage< int32_t > lower_root_delta;
+	StagedTableStorage< int8_t > tone_id_of;
+	StagedTableStorage< int8_t > hat_id_of;
+	StagedTableStorage< int8_t > tone_form_of;
+	StagedTableStorage< int8_t > hat_form_of;
+	uint32_t tone_forms[24][TONE_FORM_COUNT];
+	uint32_t hat_forms[24][HAT_FORM_COUNT];
+};
+RuntimeTables runtime_tables;
+
+#ifndef VN_LANG_TOOL_NO_PRECOMPILED
+const uint32_t (*tone_forms_UTF)[TONE_FORM_COUNT] = Precompiled::tone_forms;
+const uint32_t (*hat_forms_UTF)[HAT_FORM_COUNT] = Precompiled::hat_forms;
+// ASCII text can be lowercased without the tables, see init_plain_ascii()
+bool plain_ascii = Precompiled::plain_ascii;
+#else
+const uint32_t (*tone_forms_UTF)[TONE_FORM_COUNT] = runtime_tables.tone_forms;
+const uint32_t (*hat_forms_UTF)[HAT_FORM_COUNT] = runtime_tables.hat_forms;
+// ASCII text can be lowercased without the tables, see init_plain_ascii()
+bool plain_ascii = false;
+#endif
+
+inline uint8_t class_of(uint32_t c)
+{
+	return c < ALPHANUMERIC_SIZE ? char_class[c] : 0;
+}
+
+inline uint32_t apply_delta(const StagedTable< int32_t > &table, uint32_t c)
+{
+	return c < ALPHANUMERIC_SIZE ? c + table[c] : c;
+}
 
 std::unordered_map< std::string, std::string > transformation;
 
@@ -145,12 +303,12 @@ std::string get_transformation_string(const std::string &s)
 
 inline uint32_t lower(uint32_t c)
 {
-	return c < ALPHANUMERIC_SIZE ? lower_of[c] : c;
+	return apply_delta(lower_delta, c);
 }
 
 inline uint32_t lower_root(uint32_t c)
 {
-	return c < ALPHANUMERIC_SIZE ? lower_root_of[c] : c;
+	return apply_delta(lower_root_delta, c);
 }
 
 /*
@@ -168,16 +326,15 @@ std::vector< uint32_t > normalize_NFD_UTF(const std::vector< uint32_t > &text, b
 		uint32_t &prev_char = res.back();
 		uint32_t cur_char = text[i];
 		bool changed = false;
-		if (prev_char < ALPHANUMERIC_SIZE && (~tone_id[prev_char]) && cur_char < ALPHANUMERIC_SIZE &&
-			(~tone_forms_id[cur_char]))
+		uint8_t cur_class = class_of(cur_char);
+		if ((class_of(prev_char) & TONE_BASE) && (cur_class & TONE_MARK))
 		{
-			prev_char = tone_forms_UTF[tone_id[prev_char]][tone_forms_id[cur_char]];
+			prev_char = tone_forms_UTF[tone_id_of[prev_char]][tone_form_of[cur_char]];
 			changed = true;
 		}
-		if (prev_char < ALPHANUMERIC_SIZE && (~hat_id[prev_char]) && cur_char < ALPHANUMERIC_SIZE &&
-			(~hat_forms_id[cur_char]))
+		if ((class_of(prev_char) & HAT_BASE) && (cur_class & HAT_MARK))
 		{
-			prev_char = hat_forms_UTF[hat_id[prev_char]][hat_forms_id[cur_char]];
+			prev_char = hat_forms_UTF[hat_id_of[prev_char]][hat_form_of[cur_char]];
 			changed = true;
 		}
 		if (!changed)
@@ -191,26 +348,29 @@ std::vector< uint32_t > normalize_NFD_UTF(const std::vector< uint32_t > &text, b
 
 inline bool can_put_tone_hat(uint32_t c)
 {
-	return c < ALPHANUMERIC_SIZE && ((~tone_id[c]) || (~hat_id[c]));
+	return class_of(c) & (TONE_BASE | HAT_BASE);
 }
 
 bool is_tone_hat(uint32_t c)
 {
-	return c < ALPHANUMERIC_SIZE && ((~tone_forms_id[c]) || (~hat_forms_id[c]));
+	return class_of(c) & (TONE_MARK | HAT_MARK);
 }
 
 bool merge_tone_hat(uint32_t &prev_char, uint32_t cur_char)
 {
-	if (prev_char >= ALPHANUMERIC_SIZE || cur_char >= ALPHANUMERIC_SIZE) return false;
+	// almost no codepoint is a mark, so a single lookup settles the common case
+	uint8_t cur_class = class_of(cur_char);
+	if (!(cur_class & (TONE_MARK | HAT_MARK))) return false;
+	uint8_t prev_class = class_of(prev_char);
 
-	if ((~tone_id[prev_char]) && (~tone_forms_id[cur_char]))
+	if ((prev_class & TONE_BASE) && (cur_class & TONE_MARK))
 	{
-		prev_char = tone_forms_UTF[tone_id[prev_char]][tone_forms_id[cur_char]];
+		prev_char = tone_forms_UTF[tone_id_of[prev_char]][tone_form_of[cur_char]];
 		return true;
 	}
-	if ((~hat_id[prev_char]) && (~hat_forms_id[cur_char]))
+	if ((prev_class & HAT_BASE) && (cur_class & HAT_MARK))
 	{
-		prev_char = hat_forms_UTF[hat_id[prev_char]][hat_forms_id[cur_char]];
+		prev_char = hat_forms_UTF[hat_id_of[prev_char]][hat_form_of[cur_char]];
 		return true;
 	}
 	return false;
@@ -255,18 +415,18 @@ std::vector< uint32_t > to_UTF(const std::string &text)
 // Three frequently used functions, can remove bound-check if the codepoint is small for sure
 inline bool is_alphabetic(uint32_t c)
 {
-	return c < ALPHANUMERIC_SIZE ? in_alphabet[c] : false;
+	return class_of(c) & ALPHABETIC;
 }
 
 inline bool is_digit(uint32_t c)
 {
 	return '0' <= c && c <= '9';
-	// return c < ALPHANUMERIC_SIZE ? in_numeric[c] : false;
+	// return class_of(c) & NUMERIC;
 }
 
 inline bool is_alphanumeric(uint32_t c)
 {
-	return c < ALPHANUMERIC_SIZE ? in_alphanumeric[c] : false;
+	return class_of(c) & ALPHANUMERIC;
 }
 
 inline bool is_valid(const std::string &text)
@@ -277,53 +437,25 @@ inline bool is_valid(const std::string &text)
 std::string lower_char(uint32_t ch)
 {
 	std::string res;
-	if (ch < ALPHANUMERIC_SIZE)
-	{
-		utf8::append(lower_of[ch], std::back_inserter(res));
-	}
-	else
-	{
-		utf8::append(ch, std::back_inserter(res));
-	}
+	utf8::append(lower(ch), std::back_inserter(res));
 	return res;
 }
 
 std::string lower_root_char(uint32_t ch)
 {
 	std::string res;
-	if (ch < ALPHANUMERIC_SIZE)
-	{
-		utf8::append(lower_root_of[ch], std::back_inserter(res));
-	}
-	else
-	{
-		utf8::append(ch, std::back_inserter(res));
-	}
+	utf8::append(lower_root(ch), std::back_inserter(res));
 	return res;
 }
 
 void append_lower(std::string &s, uint32_t ch)
 {
-	if (ch < ALPHANUMERIC_SIZE)
-	{
-		utf8::append(lower_of[ch], std::back_inserter(s));
-	}
-	else
-	{
-		utf8::append(ch, std::back_inserter(s));
-	}
+	utf8::append(lower(ch), std::back_inserter(s));
 }
 
 void append_lower_root(std::string &s, uint32_t ch)
 {
-	if (ch < ALPHANUMERIC_SIZE)
-	{
-		utf8::append(lower_root_of[ch], std::back_inserter(s));
-	}
-	else
-	{
-		utf8::append(ch, std::back_inserter(s));
-	}
+	utf8::append(lower_root(ch), std::back_inserter(s));
 }
 
 std::string lower(const std::string &s)
@@ -338,35 +470,35 @@ std::string lower(const std::string &s)
 	return res;
 }
 
-std::vector< uint32_t > map(const std::vector< uint32_t > &text, uint32_t to[ALPHANUMERIC_SIZE])
+std::vector< uint32_t > map(const std::vector< uint32_t > &text, const StagedTable< int32_t > &delta)
 {
 	std::vector< uint32_t > res;
 	res.reserve(text.size());
 	for (uint32_t c : text)
 	{
-		res.push_back(c < ALPHANUMERIC_SIZE ? to[c] : c);
+		res.push_back(apply_delta(delta, c));
 	}
 	return res;
 }
 
 std::vector< uint32_t > lower(const std::vector< uint32_t > &text)
 {
-	return map(text, lower_of);
+	return map(text, lower_delta);
 }
 
 std::vector< uint32_t > root(const std::vector< uint32_t > &text)
 {
-	return map(text, root_of);
+	return map(text, root_delta);
 }
 
 std::vector< uint32_t > upper(const std::vector< uint32_t > &text)
 {
-	return map(text, upper_of);
+	return map(text, upper_delta);
 }
 
 std::vector< uint32_t > lower_root(const std::vector< uint32_t > &text)
 {
-	return map(text, lower_root_of);
+	return map(text, lower_root_delta);
 }
 
 std::string lower_root(const std::string &s)
@@ -416,24 +548,17 @@ std::string vector_to_string(const std::vector< uint32_t > &a, int begin_pos, in
 	return res;
 }
 
-int init_alphanumeric(const std::string &dict_path)
+int load_alphanumeric(std::istream &alphabetic_in, std::istream &numeric_in)
 {
-	std::ifstream fin;
-	int n;
+	int n = 0;
 
-	fin.open((dict_path + "/alphabetic").c_str());
-	if (!fin.is_open())
-	{
-		std::cerr << "Error openning file, alphabetic" << std::endl;
-		return VN_LANG_TOOL_DICT_NOT_FOUND;
-	}
-	fin >> n;
+	alphabetic_in >> n;
 	while (n--)
 	{
 		std::string upper_str, lower_str;
 		uint32_t upper_codepoint, lower_codepoint;
 		std::string line;
-		getline(fin, line);
+		getline(alphabetic_in, line);
 		std::istringstream ss(line);
 		if (ss >> upper_str >> upper_codepoint >> lower_str >> lower_codepoint)
 		{
@@ -449,20 +574,13 @@ int init_alphanumeric(const std::string &dict_path)
 			}
 		}
 	}
-	fin.close();
 
-	fin.open((dict_path + "/numeric").c_str());
-	if (!fin.is_open())
-	{
-		std::cerr << "Error openning file, numeric" << std::endl;
-		return VN_LANG_TOOL_DICT_NOT_FOUND;
-	}
-	fin >> n;
+	numeric_in >> n;
 	while (n--)
 	{
 		std::string upper_str, lower_str;
 		uint32_t upper_codepoint, lower_codepoint;
-		fin >> upper_str >> upper_codepoint >> lower_str >> lower_codepoint;
+		numeric_in >> upper_str >> upper_codepoint >> lower_str >> lower_codepoint;
 		if (std::max(upper_codepoint, lower_codepoint) >= ALPHANUMERIC_SIZE) continue;
 		in_numeric[upper_codepoint] = true;
 		in_alphanumeric[upper_codepoint] = true;
@@ -474,7 +592,6 @@ int init_alphanumeric(const std::string &dict_path)
 			lower_of[upper_codepoint] = lower_codepoint;
 		}
 	}
-	fin.close();
 
 	return VN_LANG_TOOL_INIT_OK;
 }
@@ -547,17 +664,16 @@ void init_root_forms()
 
 void init_tone_forms()
 {
-	memset(tone_forms_id, -1, sizeof tone_forms_id);
-	memset(tone_id, -1, sizeof tone_id);
+	tone_forms_id.assign(ALPHANUMERIC_SIZE, -1);
+	tone_id.assign(ALPHANUMERIC_SIZE, -1);
 	for (int i = 0; i < 24; ++i)
 	{
 		utf8::unchecked::iterator< std::string::iterator > it(tone_forms[i].begin()),
 			end_it(tone_forms[i].end());
 		tone_id[*it] = i;
-		while (it != end_it)
+		for (int j = 0; it != end_it; ++j, ++it)
 		{
-			tone_forms_UTF[i].push_back(*it);
-			it++;
+			runtime_tables.tone_forms[i][j] = *it;
 		}
 	}
 	tone_forms_id[0x301] = 1; // SAC
@@ -569,82 +685,308 @@ void init_tone_forms()
 
 void init_hat_forms()
 {
-	memset(hat_forms_id, -1, sizeof hat_forms_id);
-	memset(hat_id, -1, sizeof hat_id);
+	hat_forms_id.assign(ALPHANUMERIC_SIZE, -1);
+	hat_id.assign(ALPHANUMERIC_SIZE, -1);
 	for (int i = 0; i < 24; ++i)
 	{
 		utf8::unchecked::iterator< std::string::iterator > it(hat_forms[i].begin()), end_it(hat_forms[i].end());
 		hat_id[*it] = i;
-		while (it != end_it)
+		for (int j = 0; it != end_it; ++j, ++it)
 		{
-			hat_forms_UTF[i].push_back(*it);
-			it++;
+			runtime_tables.hat_forms[i][j] = *it;
 		}
 	}
 	hat_forms_id[0x302] = 1; // ê
 	hat_forms_id[0x306] = 2; // ă
 	hat_forms_id[0x31b] = 3; // ơ
+	tone_forms_UTF = runtime_tables.tone_forms;
+	hat_forms_UTF = runtime_tables.hat_forms;
 }
 
-int init_transformer(const std::string &dict_path)
+// lowercase with lower_of as it is at that point of init(), i.e. before init_lower_upper()
+std::string lower_while_loading(const std::string &s)
 {
-	std::ifstream fin;
-	std::string line;
-
-	fin.open((dict_path + "/d_and_gi.txt").c_str());
-	if (!fin.is_open())
+	utf8::unchecked::iterator< std::string::const_iterator > it(s.begin()), end_it(s.end());
+	std::string res;
+	while (it != end_it)
 	{
-		std::cerr << "Error openning file, d_and_gi.txt" << std::endl;
-		return VN_LANG_TOOL_DICT_NOT_FOUND;
+		uint32_t ch = *it;
+		utf8::append(ch < ALPHANUMERIC_SIZE ? lower_of[ch] : ch, std::back_inserter(res));
+		it++;
 	}
+	return res;
+}
+
+void load_transformations(std::istream &fin)
+{
+	std::string line;
 	while (getline(fin, line))
 	{
 		std::istringstream ss(line);
 		std::string from, to;
 		ss >> from >> to;
-		transformation[lower(from)] = lower(to);
+		transformation[lower_while_loading(from)] = lower_while_loading(to);
 	}
-	fin.close();
+}
+
+// what the global tables were built from: simple mode or the CRC32 of the four source files
+struct TablesSource
+{
+	bool simple_mode;
+	uint32_t crcs[4];
 
-	fin.open((dict_path + "/i_and_y.txt").c_str());
-	if (!fin.is_open())
+	bool operator==(const TablesSource &other) const
 	{
-		std::cerr << "Error openning file, i_and_y.txt" << std::endl;
-		return VN_LANG_TOOL_DICT_NOT_FOUND;
+		return simple_mode == other.simple_mode && std::equal(crcs, crcs + 4, other.crcs);
 	}
-	while (getline(fin, line))
+};
+
+bool tables_initialized = false;
+TablesSource tables_source;
+std::mutex init_mutex;
+
+TablesSource sources_of(const std::string *sources)
+{
+	TablesSource res;
+	res.simple_mode = false;
+	for (int i = 0; i < 4; ++i)
 	{
-		std::istringstream ss(line);
-		std::string from, to;
-		ss >> from >> to;
-		transformation[lower(from)] = lower(to);
+		res.crcs[i] = CRC32::crc32(sources[i].data(), sources[i].size());
 	}
-	fin.close();
+	return res;
+}
 
+/*
+** tables are global, the first successful init() or init_from_sources() fills them with build(),
+** later calls only check that they would give the same tables, and fail otherwise
+*/
+int init_once(const TablesSource &source, const std::function< int() > &build)
+{
+	std::lock_guard< std::mutex > lock(init_mutex);
+	if (tables_initialized)
+	{
+		if (source == tables_source) return VN_LANG_TOOL_INIT_OK;
+		std::cerr << "VnLangTool tables are already initialized from other sources, "
+			     "dictionaries with different vn_lang_tool files can't be used in one process"
+			  << std::endl;
+		return VN_LANG_TOOL_TABLES_MISMATCH;
+	}
+	int status_code = build();
+	if (status_code < 0) return status_code;
+	tables_source = source;
+	tables_initialized = true;
 	return VN_LANG_TOOL_INIT_OK;
 }
 
-int init(const std::string &dict_path, bool simple_mode = false)
+// lower() maps ASCII as AsciiLower does and no ASCII character merges into the previous one
+void init_plain_ascii()
+{
+	plain_ascii = true;
+	for (uint32_t c = 0; c < 0x80; ++c)
+	{
+		if (lower_of[c] != AsciiLower::lower(c) || (~tone_forms_id[c]) || (~hat_forms_id[c])) plain_ascii = false;
+	}
+}
+
+// zero-filled flat tables for loading
+void allocate_flat_tables()
 {
-	static std::atomic_flag once_flag;
-	if (once_flag.test_and_set()) return VN_LANG_TOOL_INIT_OK;
+	lower_of.assign(ALPHANUMERIC_SIZE, 0);
+	upper_of.assign(ALPHANUMERIC_SIZE, 0);
+	root_of.assign(ALPHANUMERIC_SIZE, 0);
+	lower_root_of.assign(ALPHANUMERIC_SIZE, 0);
+	in_alphabet.assign(ALPHANUMERIC_SIZE, false);
+	in_numeric.assign(ALPHANUMERIC_SIZE, false);
+	in_alphanumeric.assign(ALPHANUMERIC_SIZE, false);
+}
 
-	if (!simple_mode)
+template < class T >
+void release(std::vector< T > &table)
+{
+	std::vector< T >().swap(table);
+}
+
+// build the staged tables from the flat ones, then release the flat ones
+void build_staged_tables()
+{
+	std::vector< uint8_t > classes(ALPHANUMERIC_SIZE);
+	std::vector< int8_t > ids[4];
+	std::vector< int32_t > deltas[4];
+	const std::vector< uint32_t > *maps[4] = {&lower_of, &upper_of, &root_of, &lower_root_of};
+	const std::vector< int > *id_tables[4] = {&tone_id, &hat_id, &tone_forms_id, &hat_forms_id};
+	for (int t = 0; t < 4; ++t)
 	{
-		if (0 > init_alphanumeric(dict_path)) return VN_LANG_TOOL_DICT_NOT_FOUND;
-		if (0 > init_transformer(dict_path)) return VN_LANG_TOOL_DICT_NOT_FOUND;
+		ids[t].resize(ALPHANUMERIC_SIZE);
+		deltas[t].resize(ALPHANUMERIC_SIZE);
 	}
-	else
+	for (uint32_t c = 0; c < (uint32_t) ALPHANUMERIC_SIZE; ++c)
 	{
-		init_simple_alphanumeric();
+		classes[c] = (in_alphabet[c] ? ALPHABETIC : 0) | (in_numeric[c] ? NUMERIC : 0) |
+			     (in_alphanumeric[c] ? ALPHANUMERIC : 0) | ((~tone_id[c]) ? TONE_BASE : 0) |
+			     ((~hat_id[c]) ? HAT_BASE : 0) | ((~tone_forms_id[c]) ? TONE_MARK : 0) |
+			     ((~hat_forms_id[c]) ? HAT_MARK : 0);
+		for (int t = 0; t < 4; ++t)
+		{
+			deltas[t][c] = (int32_t) ((*maps[t])[c] - c);
+			ids[t][c] = (*id_tables[t])[c];
+		}
 	}
+	char_class = runtime_tables.char_class.build(classes);
+	lower_delta = runtime_tables.lower_delta.build(deltas[0]);
+	upper_delta = runtime_tables.upper_delta.build(deltas[1]);
+	root_delta = runtime_tables.root_delta.build(deltas[2]);
+	lower_root_delta = runtime_tables.lower_root_delta.build(deltas[3]);
+	tone_id_of = runtime_tables.tone_id_of.build(ids[0]);
+	hat_id_of = runtime_tables.hat_id_of.build(ids[1]);
+	tone_form_of = runtime_tables.tone_form_of.build(ids[2]);
+	hat_form_of = runtime_tables.hat_form_of.build(ids[3]);
+
+	release(lower_of);
+	release(upper_of);
+	release(root_of);
+	release(lower_root_of);
+	release(tone_id);
+	release(hat_id);
+	release(tone_forms_id);
+	release(hat_forms_id);
+	release(in_alphabet);
+	release(in_numeric);
+	release(in_alphanumeric);
+}
+
+// bytes taken by the tables used after init()
+size_t tables_memory_size()
+{
+	return char_class.memory_size() + lower_delta.memory_size() + upper_delta.memory_size() +
+	       root_delta.memory_size() + lower_root_delta.memory_size() + tone_id_of.memory_size() +
+	       hat_id_of.memory_size() + tone_form_of.memory_size() + hat_form_of.memory_size();
+}
+
+void init_tables()
+{
 	init_lower_upper();
 	init_root_forms();
 	init_tone_forms();
 	init_hat_forms();
+	init_plain_ascii();
+	build_staged_tables();
+}
+
+// build every table from the contents of the four files of dicts/vn_lang_tool
+int build_from_sources(const std::string &alphabetic,
+	const std::string &numeric,
+	const std::string &d_and_gi,
+	const std::string &i_and_y)
+{
+	allocate_flat_tables();
+	std::istringstream alphabetic_in(alphabetic), numeric_in(numeric);
+	if (0 > load_alphanumeric(alphabetic_in, numeric_in)) return VN_LANG_TOOL_DICT_NOT_FOUND;
+	std::istringstream d_and_gi_in(d_and_gi), i_and_y_in(i_and_y);
+	load_transformations(d_and_gi_in);
+	load_transformations(i_and_y_in);
+	init_tables();
+
+	return VN_LANG_TOOL_INIT_OK;
+}
+
+#ifndef VN_LANG_TOOL_NO_PRECOMPILED
+// the staged tables are precompiled already, only the transformations need a map
+void load_precompiled_transformations()
+{
+	for (int i = 0; i < Precompiled::transformation_count; ++i)
+	{
+		const PrecompiledTransformation &pair = Precompiled::transformations[i];
+		transformation[std::string(pair.from, pair.from_size)] = std::string(pair.to, pair.to_size);
+	}
+}
+#endif
+
+// use the precompiled tables when the sources are those they were compiled from, rebuild otherwise
+int init_sources(const std::string &alphabetic,
+	const std::string &numeric,
+	const std::string &d_and_gi,
+	const std::string &i_and_y)
+{
+#ifndef VN_LANG_TOOL_NO_PRECOMPILED
+	if (CRC32::crc32(alphabetic.data(), alphabetic.size()) == Precompiled::alphabetic_crc &&
+		CRC32::crc32(numeric.data(), numeric.size()) == Precompiled::numeric_crc &&
+		CRC32::crc32(d_and_gi.data(), d_and_gi.size()) == Precompiled::d_and_gi_crc &&
+		CRC32::crc32(i_and_y.data(), i_and_y.size()) == Precompiled::i_and_y_crc)
+	{
+		load_precompiled_transformations();
+		return VN_LANG_TOOL_INIT_OK;
+	}
+#endif
+	return build_from_sources(alphabetic, numeric, d_and_gi, i_and_y);
+}
 
+int read_source(const std::string &file_path, std::string &content)
+{
+	std::ifstream fin(file_path.c_str(), std::ios::binary);
+	if (!fin.is_open()) return VN_LANG_TOOL_DICT_NOT_FOUND;
+	content.assign(std::istreambuf_iterator< char >(fin), std::istreambuf_iterator< char >());
 	return VN_LANG_TOOL_INIT_OK;
 }
+
+/*
+** files in dict_path override the precompiled tables, which are used as they are when the files
+** are missing or the same as at build time
+*/
+int init(const std::string &dict_path, bool simple_mode = false)
+{
+	if (simple_mode)
+	{
+		TablesSource source = {true, {0, 0, 0, 0}};
+		return init_once(source,
+			[]()
+			{
+				allocate_flat_tables();
+				init_simple_alphanumeric();
+				init_tables();
+				return VN_LANG_TOOL_INIT_OK;
+			});
+	}
+
+	const char *file_names[] = {"alphabetic", "numeric", "d_and_gi.txt", "i_and_y.txt"};
+	std::string sources[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		if (0 > read_source(dict_path + "/" + file_names[i], sources[i]))
+		{
+#ifndef VN_LANG_TOOL_NO_PRECOMPILED
+			TablesSource source = {false,
+				{Precompiled::alphabetic_crc,
+					Precompiled::numeric_crc,
+					Precompiled::d_and_gi_crc,
+					Precompiled::i_and_y_crc}};
+			return init_once(source,
+				[]()
+				{
+					load_precompiled_transformations();
+					return VN_LANG_TOOL_INIT_OK;
+				});
+#else
+			std::cerr << "Error openning file, " << file_names[i] << std::endl;
+			return VN_LANG_TOOL_DICT_NOT_FOUND;
+#endif
+		}
+	}
+	return init_once(sources_of(sources),
+		[&sources]() { return init_sources(sources[0], sources[1], sources[2], sources[3]); });
+}
+
+/*
+** same as init() with the contents of the four files of dict_path, e.g. from a dictionary bundle
+*/
+int init_from_sources(const std::string &alphabetic,
+	const std::string &numeric,
+	const std::string &d_and_gi,
+	const std::string &i_and_y)
+{
+	const std::string sources[4] = {alphabetic, numeric, d_and_gi, i_and_y};
+	return init_once(sources_of(sources),
+		[&sources]() { return init_sources(sources[0], sources[1], sources[2], sources[3]); });
+}
 }
 
 #endif // VN_LANG_TOOL_HPP
@@ -0,0 +1,260 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+/*
+** Fixed-size pool of persistent threads running parallel loops over an index range
+** parallel_for() splits [0, count) evenly among the workers, each worker takes indices
+** from the front of its own range, and once that is empty it steals the back half
+** of the range of some other worker, so uneven items (long and short texts) still keep
+** every worker busy until the very end
+** The calling thread is worker 0, so a pool of size 1 has no threads at all
+** A loop limited to n workers runs on workers [0, n) only, the other threads sit it out
+*/
+class WorkStealingPool
+{
+public:
+	// fn(worker, index), worker is in [0, size()), calls with the same worker never run concurrently
+	typedef std::function< void(int, size_t) > task_t;
+
+	explicit WorkStealingPool(int n_workers)
+	    : task(nullptr), active_workers(0), running_threads(0), generation(0), stopping(false)
+	{
+		if (n_workers < 1) n_workers = 1;
+		for (int i = 0; i < n_workers; ++i)
+		{
+			ranges.push_back(std::unique_ptr< WorkerRange >(new WorkerRange()));
+		}
+		for (int i = 1; i < n_workers; ++i)
+		{
+			threads.push_back(std::thread(&WorkStealingPool::thread_loop, this, i));
+		}
+	}
+
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+	~WorkStealingPool()
+	{
+		{
+			std::lock_guard< std::mutex > lock(state_mutex);
+			stopping = true;
+		}
+		start_cv.notify_all();
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	inline int size() const
+	{
+		return ranges.size();
+	}
+
+	/*
+	** call fn(worker, index) for every index in [0, count) using at most max_workers workers
+	** (all of them when max_workers <= 0) and block until all calls are done
+	** the first exception thrown by fn is rethrown here after the loop has drained
+	** parallel loops from different threads are run one after another
+	** a call made from inside fn on the same pool (a nested loop) would wait for the loop it runs in,
+	** so it runs all its indices inline on the calling thread, as the worker that thread is running
+	** fn must not wait for another thread that calls parallel_for() on this pool, that deadlocks
+	*/
+	void parallel_for(size_t count, const task_t &fn, int max_workers = 0)
+	{
+		if (count == 0) return;
+		const RunningWorker &running = running_worker();
+		if (running.pool == this)
+		{
+			run_inline(count, fn, running.worker);
+			return;
+		}
+		std::lock_guard< std::mutex > run_lock(run_mutex);
+
+		int n_workers = max_workers <= 0 || max_workers > size() ? size() : max_workers;
+		if (n_workers > (int) count) n_workers = count;
+		for (int i = 0; i < size(); ++i)
+		{
+			// no thread is running a loop now, but the steal path reads ranges under their mutexes
+			std::lock_guard< std::mutex > lock(ranges[i]->mutex);
+			ranges[i]->begin = i < n_workers ? count * i / n_workers : 0;
+			ranges[i]->end = i < n_workers ? count * (i + 1) / n_workers : 0;
+		}
+
+		{
+			std::lock_guard< std::mutex > lock(state_mutex);
+			task = &fn;
+			active_workers = n_workers;
+			first_exception = nullptr;
+			running_threads = threads.size();
+			generation++;
+		}
+		start_cv.notify_all();
+
+		run_worker(0);
+
+		std::unique_lock< std::mutex > lock(state_mutex);
+		done_cv.wait(lock, [this] { return running_threads == 0; });
+		task = nullptr;
+		if (first_exception)
+		{
+			std::exception_ptr exception = first_exception;
+			first_exception = nullptr;
+			std::rethrow_exception(exception);
+		}
+	}
+
+private:
+	struct WorkerRange
+	{
+		std::mutex mutex;
+		size_t begin;
+		size_t end;
+		char padding[64]; // keep ranges of different workers off the same cache line
+
+		WorkerRange() : begin(0), end(0)
+		{
+		}
+	};
+
+	std::vector< std::unique_ptr< WorkerRange > > ranges;
+	std::vector< std::thread > threads;
+
+	std::mutex run_mutex; // serializes parallel_for() calls, except nested ones
+	std::mutex state_mutex;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+	const task_t *task;
+	int active_workers; // workers of the current loop, [0, active_workers)
+	std::exception_ptr first_exception;
+	size_t running_threads;
+	unsigned long generation;
+	bool stopping;
+
+	// the pool and worker whose task the calling thread is running, pool is nullptr outside of tasks
+	struct RunningWorker
+	{
+		const WorkStealingPool *pool;
+		int worker;
+	};
+
+	static RunningWorker &running_worker()
+	{
+		static thread_local RunningWorker running = {nullptr, 0};
+		return running;
+	}
+
+	// nested loop, same exception handling as parallel_for()
+	static void run_inline(size_t count, const task_t &fn, int worker)
+	{
+		std::exception_ptr exception;
+		for (size_t index = 0; index < count; ++index)
+		{
+			try
+			{
+				fn(worker, index);
+			}
+			catch (...)
+			{
+				if (!exception) exception = std::current_exception();
+			}
+		}
+		if (exception) std::rethrow_exception(exception);
+	}
+
+	// take the next index of worker's own range
+	bool pop_own(int worker, size_t &index)
+	{
+		WorkerRange &range = *ranges[worker];
+		std::lock_guard< std::mutex > lock(range.mutex);
+		if (range.begin >= range.end) return false;
+		index = range.begin++;
+		return true;
+	}
+
+	// move the back half of some other active worker's range into worker's own range, return false when all are empty
+	bool steal(int worker)
+	{
+		int n = active_workers;
+		for (int offset = 1; offset < n; ++offset)
+		{
+			WorkerRange &victim = *ranges[(worker + offset) % n];
+			size_t begin, end;
+			{
+				std::lock_guard< std::mutex > lock(victim.mutex);
+				if (victim.begin >= victim.end) continue;
+				end = victim.end;
+				begin = victim.begin + (victim.end - victim.begin) / 2;
+				victim.end = begin;
+			}
+			WorkerRange &own = *ranges[worker];
+			std::lock_guard< std::mutex > lock(own.mutex);
+			own.begin = begin;
+			own.end = end;
+			return true;
+		}
+		return false;
+	}
+
+	void run_worker(int worker)
+	{
+		const task_t &fn = *task;
+		RunningWorker &running = running_worker();
+		RunningWorker outer = running;
+		running.pool = this;
+		running.worker = worker;
+		size_t index;
+		while (true)
+		{
+			if (!pop_own(worker, index))
+			{
+				if (!steal(worker)) break;
+				continue;
+			}
+			try
+			{
+				fn(worker, index);
+			}
+			catch (...)
+			{
+				std::lock_guard< std::mutex > lock(state_mutex);
+				if (!first_exception) first_exception = std::current_exception();
+			}
+		}
+		running = outer;
+	}
+
+	void thread_loop(int worker)
+	{
+		unsigned long seen_generation = 0;
+		while (true)
+		{
+			bool active;
+			{
+				std::unique_lock< std::mutex > lock(state_mutex);
+				start_cv.wait(lock, [this, seen_generation] { return stopping || generation != seen_generation; });
+				if (stopping) return;
+				seen_generation = generation;
+				active = worker < active_workers;
+			}
+
+			if (active) run_worker(worker);
+
+			{
+				std::lock_guard< std::mutex > lock(state_mutex);
+				running_threads--;
+			}
+			done_cv.notify_one();
+		}
+	}
+};
+
+#endif // WORK_STEALING_POOL_HPP
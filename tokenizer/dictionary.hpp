@@ -0,0 +1,159 @@
+#ifndef TOKENIZER_DICTIONARY_HPP
+#define TOKENIZER_DICTIONARY_HPP
+
+#include <string>
+#include <memory>
+#include <iostream>
+#include <sys/stat.h>
+#include <tokenizer/config.h>
+#include "auxiliary/vn_lang_tool.hpp"
+#include "auxiliary/trie.hpp"
+#include "auxiliary/csr_matrix.hpp"
+#include "auxiliary/dict_bundle.hpp"
+
+/*
+** Dictionary data used by Tokenizer, immutable once loaded
+** Tokenizer handles keep it through a shared_ptr, so any number of them (one per thread, or
+** several dictionary versions side by side) can share one copy, and it's freed with the last handle
+** VnLangTool tables are process-wide and are not part of it, the first dictionary loaded sets them
+** and loading one with other vn_lang_tool sources fails (see VnLangTool::init_once())
+*/
+class TokenizerDictionary
+{
+public:
+	// Note: both Trie saves toned terms
+	MultitermDATrie multiterm_trie;
+	SyllableDATrie syllable_trie;
+
+	// Sparse 2D array of weights, indexed by syllable indices from syllable_trie
+	// Used for retrieving 2-gram weights in sticky-text-segmentation
+	CSRMatrix nontone_pair_scores;
+
+	/*
+	** load the dictionary at dict_path into dictionary, which is left untouched on failure
+	** VnLangTool tables are only initialized once all dumps have loaded
+	** dict_path is a dictionary bundle, a directory containing one (DICT_BUNDLE), or a directory
+	** with the separate dumps and VnLangTool files, a bundle is preferred when both are present
+	** use_mmap = true maps dictionary dumps read-only instead of copying them into memory,
+	** startup is almost instant and processes on one host share the same pages
+	** bundles are always mapped, there use_mmap = false verifies the checksum of every section on startup
+	*/
+	static int load(const std::string &dict_path,
+		std::shared_ptr< const TokenizerDictionary > &dictionary,
+		bool load_nontone_data = true,
+		bool use_mmap = false)
+	{
+		std::shared_ptr< TokenizerDictionary > loaded(new TokenizerDictionary());
+		int status_code = 0;
+		std::string bundle_path;
+		if (find_bundle(dict_path, bundle_path))
+		{
+			if (0 > (status_code = loaded->load_bundle(bundle_path, load_nontone_data, !use_mmap)))
+				return status_code;
+		}
+		else
+		{
+			if (0 > (status_code = loaded->load_serialized_dicts(dict_path, load_nontone_data, use_mmap)))
+				return status_code;
+			if (0 > (status_code = VnLangTool::init(dict_path))) return status_code;
+		}
+		dictionary = loaded;
+		return 0;
+	}
+
+private:
+	template < class Dump >
+	static int load_dump(Dump &dump, const std::string &file_path, bool use_mmap)
+	{
+		return use_mmap ? dump.map_from_file(file_path) : dump.read_from_file(file_path);
+	}
+
+	int load_serialized_dicts(const std::string &dict_path, bool load_nontone_data, bool use_mmap)
+	{
+		int status_code = 0;
+		if (0 > (status_code = load_dump(multiterm_trie, dict_path + '/' + MULTITERM_DICT_DUMP, use_mmap)))
+			return status_code;
+		if (load_nontone_data)
+		{
+			if (0 > (status_code = load_dump(syllable_trie, dict_path + '/' + SYLLABLE_DICT_DUMP, use_mmap)))
+				return status_code;
+			if (0 > (status_code = load_dump(
+					 nontone_pair_scores, dict_path + '/' + NONTONE_PAIR_DICT_DUMP, use_mmap)))
+				return status_code;
+		}
+		return 0;
+	}
+
+	// dict_path itself if it is a file, otherwise DICT_BUNDLE inside it if that exists
+	static bool find_bundle(const std::string &dict_path, std::string &bundle_path)
+	{
+		struct stat st;
+		if (stat(dict_path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+		{
+			bundle_path = dict_path;
+			return true;
+		}
+		std::string candidate = dict_path + '/' + DICT_BUNDLE;
+		if (stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+		{
+			bundle_path = candidate;
+			return true;
+		}
+		return false;
+	}
+
+	template < class Dump >
+	static int attach_section(const DictBundle &bundle, uint32_t section_id, Dump &dump)
+	{
+		const char *data;
+		size_t size;
+		if (!bundle.find_section(section_id, data, size))
+		{
+			std::cerr << "Missing section " << section_id << " in dictionary bundle" << std::endl;
+			return -1;
+		}
+		if (0 > dump.attach(data, size)) return -1;
+		dump.mapped_file = bundle.mapped_file; // keeps the mapping alive as long as the dump is used
+		return 0;
+	}
+
+	int load_bundle(const std::string &bundle_path, bool load_nontone_data, bool verify_sections)
+	{
+		DictBundle bundle;
+		int status_code = 0;
+		if (0 > (status_code = bundle.map_from_file(bundle_path, verify_sections))) return status_code;
+
+		if (0 > (status_code = attach_section(bundle, DictBundle::MULTITERM_TRIE, multiterm_trie)))
+			return status_code;
+		if (load_nontone_data)
+		{
+			if (0 > (status_code = attach_section(bundle, DictBundle::SYLLABLE_TRIE, syllable_trie)))
+				return status_code;
+			if (0 > (status_code = attach_section(bundle, DictBundle::NONTONE_PAIR_SCORES, nontone_pair_scores)))
+				return status_code;
+		}
+
+		// VnLangTool tables are global, so they come last, once nothing else can fail
+		const char *data;
+		size_t size;
+		for (uint32_t section_id : {DictBundle::VN_ALPHABETIC,
+			     DictBundle::VN_NUMERIC,
+			     DictBundle::VN_D_AND_GI,
+			     DictBundle::VN_I_AND_Y})
+		{
+			if (!bundle.find_section(section_id, data, size))
+			{
+				std::cerr << "Missing section " << section_id << " in dictionary bundle" << std::endl;
+				return -1;
+			}
+		}
+		if (0 > (status_code = VnLangTool::init_from_sources(bundle.section_string(DictBundle::VN_ALPHABETIC),
+				 bundle.section_string(DictBundle::VN_NUMERIC),
+				 bundle.section_string(DictBundle::VN_D_AND_GI),
+				 bundle.section_string(DictBundle::VN_I_AND_Y))))
+			return status_code;
+		return 0;
+	}
+};
+
+#endif // TOKENIZER_DICTIONARY_HPP
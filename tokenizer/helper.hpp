@@ -8,8 +8,8 @@
 
 namespace Helper
 {
-StringSetTrie DOMAIN_FIELDs{"com", "net", "org", "info", "gov", "edu", "biz"};
-StringSetTrie DOMAIN_ENDs{"com",
+const StringSetTrie DOMAIN_FIELDs{"com", "net", "org", "info", "gov", "edu", "biz"};
+const StringSetTrie DOMAIN_ENDs{"com",
 	"net",
 	"org",
 	"info",
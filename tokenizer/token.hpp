@@ -2,6 +2,8 @@
 #define TOKENIZER_TOKEN_HPP
 
 #include <sstream>
+#include <string>
+#include <vector>
 #include "auxiliary/vn_lang_tool.hpp"
 
 // Used in JNI
@@ -74,7 +76,7 @@ struct Token
 	{
 	}
 
-	inline bool is_url_related()
+	inline bool is_url_related() const
 	{
 		return seg_type == URL_SEG_TYPE || seg_type == END_URL_TYPE;
 	}
@@ -150,4 +152,46 @@ struct FullToken : Token
 	}
 };
 
+/*
+** Tokens of one text without a string per token
+** All token texts (what FullToken::text would hold) are stored back to back in one buffer,
+** token i spans [text_offsets[i], text_offsets[i + 1]) of normalized
+** original_start and original_end of every token are byte offsets into the input, so views
+** into the input itself don't need normalized at all
+*/
+struct SegmentedText
+{
+	std::string normalized;
+	std::vector< Token > tokens;
+	std::vector< int32_t > text_offsets; // tokens.size() + 1 entries
+
+	inline size_t size() const
+	{
+		return tokens.size();
+	}
+
+	inline const char *token_data(size_t i) const
+	{
+		return normalized.data() + text_offsets[i];
+	}
+
+	inline size_t token_length(size_t i) const
+	{
+		return text_offsets[i + 1] - text_offsets[i];
+	}
+
+	// copies, prefer token_data() and token_length() on hot paths
+	std::string token_text(size_t i) const
+	{
+		return std::string(token_data(i), token_length(i));
+	}
+
+	void clear()
+	{
+		normalized.clear();
+		tokens.clear();
+		text_offsets.clear();
+	}
+};
+
 #endif // TOKENIZER_TOKEN_HPP
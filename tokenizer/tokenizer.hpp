@@ -5,14 +5,16 @@
 #include <climits>
 #include <algorithm>
 #include <string>
+#include <memory>
 #include <tokenizer/config.h>
 #include "auxiliary/vn_lang_tool.hpp"
-#include "auxiliary/trie.hpp"
-#include "auxiliary/buffered_reader.hpp"
-#include "auxiliary/sparsepp/spp.h"
-#include "auxiliary/file_serializer.hpp"
+#include "auxiliary/ascii_lower.hpp"
+#include "auxiliary/work_stealing_pool.hpp"
+#include "auxiliary/lru_cache.hpp"
+#include "dictionary.hpp"
 #include "helper.hpp"
 #include "token.hpp"
+#include "workspace.hpp"
 
 class Tokenizer
 {
@@ -21,20 +23,31 @@ public:
 	static const int TOKENIZE_HOST = 1;
 	static const int TOKENIZE_URL = 2;
 
-	// This is quite fast, can change this to something else if we want
-	// to reduce memory consumption or improve speed
-	// remember to change dict_compiler.cpp also
-	typedef spp::sparse_hash_map< int, float > fast_map_t;
 	typedef int trie_node_t; // nodes are indexed by non-negative integers in DATrie
 
-	// Note: both Trie saves toned terms
-	MultitermDATrie multiterm_trie;
-	SyllableDATrie syllable_trie;
+	// FNV-1a over codepoints
+	struct CodepointsHash
+	{
+		size_t operator()(const std::vector< uint32_t > &text) const
+		{
+			uint64_t h = 14695981039346656037ULL;
+			for (uint32_t c : text)
+			{
+				h = (h ^ c) * 1099511628211ULL;
+			}
+			return h;
+		}
+	};
 
-private:
-	// An array of HashMaps, represent sparse 2D array of weights
-	// Used for retrieving 2-gram weights in sticky-text-segmentation
-	std::vector< fast_map_t > nontone_pair_freq_map;
+	// sticky segmentation (space_positions) of alphanumeric runs, see set_sticky_cache_capacity()
+	typedef ShardedLruCache< std::vector< uint32_t >, std::vector< int >, CodepointsHash > StickyCache;
+	// longer runs are segmented without the cache, they hardly repeat
+	static const int STICKY_CACHE_MAX_LENGTH = 256;
+
+	// results of segment() by text and options, see set_query_cache_capacity()
+	typedef ShardedLruCache< std::string, std::vector< FullToken > > QueryCache;
+	// longer texts (in bytes) are not cached, they are documents rather than queries
+	static const int QUERY_CACHE_MAX_LENGTH = 1024;
 
 	struct Range
 	{
@@ -70,57 +83,56 @@ private:
 		}
 	};
 
-	int unserialize_nontone_data(const std::string &file_name)
+private:
+	std::shared_ptr< const TokenizerDictionary > dictionary;
+
+	std::unique_ptr< StickyCache > sticky_cache;
+	std::unique_ptr< QueryCache > query_cache;
+
+	std::vector< std::string > to_string_list(std::vector< FullToken > tokens)
 	{
-		FILE *in = fopen(file_name.c_str(), "rb");
-		if (in == nullptr)
-		{
-			std::cerr << "Error: cannot open " << file_name << " for reading" << std::endl;
-			return -1;
-		}
-		int n = 0;
-		if (fread(&n, sizeof(n), 1, in) != 1) {
-			fclose(in);
-			return -1;
-		}
-		nontone_pair_freq_map.resize(n);
-		FileSerializer serializer;
-		for (int i = 0; i < n; ++i)
+		std::vector< std::string > res;
+		res.reserve(tokens.size());
+		for (FullToken &token : tokens)
 		{
-			nontone_pair_freq_map[i].unserialize(serializer, in);
+			res.push_back(std::move(token.text));
 		}
-		fclose(in);
-		return 0;
+		return res;
 	}
 
-	int load_serialized_dicts(const std::string &dict_path, bool load_nontone_data)
+	/*
+	** append the UTF-8 text of token to out, with the spaces inserted by sticky text segmentation
+	** space_it walks through space_positions (terminated by -1) across the tokens of one text
+	*/
+	static void append_token_text(const std::vector< uint32_t > &text,
+		const std::vector< int > &space_positions,
+		const Token &token,
+		bool for_transforming,
+		int &space_it,
+		std::string &out)
 	{
-		int status_code = 0;
-		if (0 > (status_code = multiterm_trie.read_from_file(dict_path + '/' + MULTITERM_DICT_DUMP)))
-			return status_code;
-		if (load_nontone_data)
+		for (int pos = token.normalized_start; pos < token.normalized_end; ++pos)
 		{
-			if (0 > (status_code = syllable_trie.read_from_file(dict_path + '/' + SYLLABLE_DICT_DUMP)))
-				return status_code;
-			if (0 > (status_code = unserialize_nontone_data(dict_path + '/' + NONTONE_PAIR_DICT_DUMP)))
-				return status_code;
+			if (space_positions[space_it] == pos)
+			{
+				out += (for_transforming ? '_' : ' ');
+				space_it++;
+			}
+			utf8::append(text[pos], std::back_inserter(out));
 		}
-		return 0;
 	}
 
-	std::vector< std::string > to_string_list(const std::vector< FullToken > &tokens)
+public:
+	Tokenizer() : dictionary(std::make_shared< const TokenizerDictionary >())
 	{
-		std::vector< std::string > res;
-		res.reserve(tokens.size());
-		for (auto it : tokens)
-		{
-			res.push_back(it.text);
-		}
-		return res;
 	}
 
-public:
-	Tokenizer()
+	/*
+	** a handle on a dictionary loaded with TokenizerDictionary::load() or taken from another handle,
+	** handles are cheap to create and share the dictionary, e.g. one per thread or one per dictionary version
+	** caches (see set_sticky_cache_capacity()) belong to the handle and are not shared
+	*/
+	explicit Tokenizer(std::shared_ptr< const TokenizerDictionary > dictionary) : dictionary(std::move(dictionary))
 	{
 	}
 
@@ -130,14 +142,87 @@ public:
 		return tokenizer_object;
 	}
 
-	int initialize(const std::string &dict_path, bool load_nontone_data = true)
+	// workspace of the calling thread, used by the overloads which don't take one
+	static TokenizerWorkspace &thread_workspace()
+	{
+		static thread_local TokenizerWorkspace workspace;
+		return workspace;
+	}
+
+	// pool shared by the whole process for batches, with one worker per hardware thread
+	static WorkStealingPool &batch_pool()
+	{
+		static WorkStealingPool pool(std::max(1, (int) std::thread::hardware_concurrency()));
+		return pool;
+	}
+
+	/*
+	** dict_path is a dictionary bundle, a directory containing one (DICT_BUNDLE), or a directory
+	** with the separate dumps and VnLangTool files, a bundle is preferred when both are present
+	** use_mmap = true maps dictionary dumps read-only instead of copying them into memory,
+	** startup is almost instant and processes on one host share the same pages
+	** bundles are always mapped, there use_mmap = false verifies the checksum of every section on startup
+	** the new dictionary replaces the one of this handle only, on failure the current one is kept
+	*/
+	int initialize(const std::string &dict_path, bool load_nontone_data = true, bool use_mmap = false)
 	{
+		std::shared_ptr< const TokenizerDictionary > loaded;
 		int status_code = 0;
-		if (0 > (status_code = VnLangTool::init(dict_path))) return status_code;
-		if (0 > (status_code = load_serialized_dicts(dict_path, load_nontone_data))) return status_code;
+		if (0 > (status_code = TokenizerDictionary::load(dict_path, loaded, load_nontone_data, use_mmap)))
+			return status_code;
+		set_dictionary(loaded);
 		return 0;
 	}
 
+	const std::shared_ptr< const TokenizerDictionary > &get_dictionary() const
+	{
+		return dictionary;
+	}
+
+	/*
+	** switch this handle to another dictionary, other handles keep theirs
+	** must not be called while other threads tokenize with this handle
+	*/
+	void set_dictionary(std::shared_ptr< const TokenizerDictionary > new_dictionary)
+	{
+		if (!new_dictionary) return;
+		dictionary = std::move(new_dictionary);
+		if (sticky_cache) sticky_cache->clear();
+		if (query_cache) query_cache->clear();
+	}
+
+	/*
+	** cache the sticky segmentation of up to capacity alphanumeric runs (parts of urls and hosts),
+	** so that repeated ones cost a hash lookup instead of the dynamic programming
+	** capacity = 0 (the default) disables the cache, must not be called while other threads tokenize
+	*/
+	void set_sticky_cache_capacity(size_t capacity)
+	{
+		sticky_cache.reset(capacity > 0 ? new StickyCache(capacity) : nullptr);
+	}
+
+	// nullptr when disabled, hits() and misses() count lookups since it was enabled
+	StickyCache *get_sticky_cache()
+	{
+		return sticky_cache.get();
+	}
+
+	/*
+	** cache the tokens segment() gives for up to capacity texts (of up to QUERY_CACHE_MAX_LENGTH bytes),
+	** keyed by the text and all options, the least recently used ones are evicted
+	** capacity = 0 (the default) disables the cache, must not be called while other threads tokenize
+	*/
+	void set_query_cache_capacity(size_t capacity)
+	{
+		query_cache.reset(capacity > 0 ? new QueryCache(capacity) : nullptr);
+	}
+
+	// nullptr when disabled, capacity(), hits(), misses() and hit_rate() since it was enabled
+	QueryCache *get_query_cache()
+	{
+		return query_cache.get();
+	}
+
 	std::string to_string_range(const std::vector< uint32_t > &text, int left, int right)
 	{
 		std::string res;
@@ -160,6 +245,7 @@ public:
 		int &last_delimiter_pos = state.last_delimiter_pos;
 		bool &numeric_prefix = state.numeric_prefix;
 		bool &in_dict = state.in_dict;
+		const MultitermDATrie &multiterm_trie = dictionary->multiterm_trie;
 
 		for (int i = from; i <= length; ++i)
 		{
@@ -168,7 +254,8 @@ public:
 				last_delimiter_pos = i - 1;
 			}
 			// If appending the current character don't make the buffer out of dict, then do it
-			if (in_dict && i < length && multiterm_trie.has_child(cur_node, text[i]))
+			trie_node_t next_node = in_dict && i < length ? multiterm_trie.try_child(cur_node, text[i]) : -1;
+			if (~next_node)
 			{
 				// If the current character is a space, then cut here, there's more to process though
 				if (text[i] == ' ' && i != from)
@@ -188,7 +275,7 @@ public:
 					numeric_prefix = false;
 				}
 
-				cur_node = multiterm_trie.get_child(cur_node, text[i]);
+				cur_node = next_node;
 			}
 			else
 			{ // This is when we went out of dict, use heuristics to extract the next token
@@ -314,38 +401,39 @@ public:
 		return Range();
 	}
 
-	// function used in JNI
+	/*
+	** function used in JNI
+	** original_text is encoded in UTF-16, surrogate pairs are decoded into one codepoint while
+	** unpaired surrogates are kept as they are, original_pos are in UTF-16 units (Java string indices)
+	*/
 	void normalize_for_tokenization(const unsigned short *original_text,
 		int length,
 		std::vector< uint32_t > &text,
 		std::vector< int > &original_pos,
 		bool calc_original_pos)
 	{
-		// TODO: original_text is encoded in UTF-16, convert to UTF-32
 		if (calc_original_pos)
 		{
-			original_pos.reserve(length + 1);
+			original_pos.reserve(original_pos.size() + length + 1);
 		}
+		text.reserve(text.size() + length);
 
 		for (int i = 0; i < length; ++i)
 		{
-			uint32_t cur_char = VnLangTool::lower(original_text[i]);
-			if (i > 0)
+			int cur_position = i;
+			uint32_t cur_char = original_text[i];
+			if (cur_char >= 0xD800 && cur_char < 0xDC00 && i + 1 < length && original_text[i + 1] >= 0xDC00 &&
+				original_text[i + 1] < 0xE000)
 			{
-				if (!VnLangTool::merge_tone_hat(text.back(), cur_char))
-				{
-					if (calc_original_pos)
-					{
-						original_pos.push_back(i);
-					}
-					text.push_back(cur_char);
-				}
+				cur_char = 0x10000 + ((cur_char - 0xD800) << 10) + (original_text[i + 1] - 0xDC00);
+				++i;
 			}
-			else
+			cur_char = VnLangTool::lower(cur_char);
+			if (cur_position == 0 || !VnLangTool::merge_tone_hat(text.back(), cur_char))
 			{
 				if (calc_original_pos)
 				{
-					original_pos.push_back(i);
+					original_pos.push_back(cur_position);
 				}
 				text.push_back(cur_char);
 			}
@@ -353,32 +441,56 @@ public:
 		if (calc_original_pos) original_pos.push_back(length);
 	}
 
-	// function used in C++ code
+	/*
+	** function used in C++ code
+	** ASCII runs are converted in bulk (see AsciiLower), only the other codepoints are decoded one by one
+	*/
 	void normalize_for_tokenization(
 		const std::string &original_text, std::vector< uint32_t > &text, std::vector< int > &original_pos)
 	{
-		original_pos.reserve(original_text.length() + 1);
-		const char *cur_pointer = &original_text[0];
+		// every codepoint takes at least one byte, so the buffers are sized for the worst case and trimmed at the end
+		size_t text_size = text.size();
+		size_t pos_size = original_pos.size();
+		text.resize(text_size + original_text.size());
+		original_pos.resize(pos_size + original_text.size() + 1);
+
+		const char *begin_pointer = original_text.data();
+		const char *cur_pointer = begin_pointer;
 		const char *end_pointer = cur_pointer + original_text.size();
 		while (cur_pointer < end_pointer)
 		{
-			int cur_position = cur_pointer - &original_text[0];
-			int cur_codepoint = VnLangTool::lower(utf8::unchecked::next(cur_pointer));
-			if (!text.empty())
+			if (VnLangTool::plain_ascii)
 			{
-				if (!VnLangTool::merge_tone_hat(text.back(), cur_codepoint))
-				{
-					original_pos.push_back(cur_position);
-					text.push_back(cur_codepoint);
-				}
+				size_t converted = AsciiLower::convert_prefix(cur_pointer,
+					end_pointer - cur_pointer,
+					&text[text_size],
+					&original_pos[pos_size],
+					cur_pointer - begin_pointer);
+				text_size += converted;
+				pos_size += converted;
+				cur_pointer += converted;
+				if (cur_pointer == end_pointer) break;
 			}
-			else
+			int cur_position = cur_pointer - begin_pointer;
+			uint32_t cur_codepoint = VnLangTool::lower(utf8::unchecked::next(cur_pointer));
+			if (text_size == 0 || !VnLangTool::merge_tone_hat(text[text_size - 1], cur_codepoint))
 			{
-				original_pos.push_back(cur_position);
-				text.push_back(cur_codepoint);
+				original_pos[pos_size++] = cur_position;
+				text[text_size++] = cur_codepoint;
 			}
 		}
-		original_pos.push_back(original_text.length());
+		original_pos[pos_size++] = original_text.length();
+		text.resize(text_size);
+		original_pos.resize(pos_size);
+	}
+
+	// normalize original_text into the text buffers of workspace, space_positions is cleared as well
+	void normalize_to_workspace(const std::string &original_text, TokenizerWorkspace &workspace)
+	{
+		workspace.text.clear();
+		workspace.original_pos.clear();
+		workspace.space_positions.clear();
+		normalize_for_tokenization(original_text, workspace.text, workspace.original_pos);
 	}
 
 	inline bool maximize(double &a, double b)
@@ -412,9 +524,60 @@ public:
 		bool tokenize_sticky = true,
 		bool keep_puncts = true)
 	{
-		std::vector< double > best_scores(length + 1, 0);
-		std::vector< int > trace(length + 1, -1);
-		std::vector< bool > is_special(length + 1, 0);
+		run_tokenize< T >(text,
+			length,
+			ranges,
+			space_positions,
+			for_transforming,
+			tokenize_sticky,
+			keep_puncts,
+			thread_workspace());
+	}
+
+	template < class T >
+	void run_tokenize(uint32_t *text,
+		int length,
+		std::vector< T > &ranges,
+		std::vector< int > &space_positions,
+		bool for_transforming,
+		bool tokenize_sticky,
+		bool keep_puncts,
+		TokenizerWorkspace &workspace)
+	{
+		run_tokenize_reversed(text, length, ranges, space_positions, tokenize_sticky, workspace);
+
+		// Now ranges store tokens in reverse order (from end to begin of the text)
+		std::reverse(ranges.begin(), ranges.end());
+		if (keep_puncts)
+		{
+			insert_puncts(text, length, ranges, for_transforming);
+		}
+		if (tokenize_sticky)
+		{
+			std::reverse(space_positions.begin(), space_positions.end());
+		}
+	}
+
+	/*
+	** the DP core of run_tokenize()
+	** appends tokens (without PUNCTs) to ranges and split positions to space_positions,
+	** both in reverse order, i.e. from the end to the beginning of the text
+	*/
+	template < class T >
+	void run_tokenize_reversed(uint32_t *text,
+		int length,
+		std::vector< T > &ranges,
+		std::vector< int > &space_positions,
+		bool tokenize_sticky,
+		TokenizerWorkspace &workspace)
+	{
+		TokenizerWorkspace::SplitBuffers &split = workspace.split_buffers(tokenize_sticky);
+		std::vector< double > &best_scores = split.best_scores;
+		std::vector< int > &trace = split.trace;
+		std::vector< char > &is_special = split.is_special;
+		best_scores.assign(length + 1, 0);
+		trace.assign(length + 1, -1);
+		is_special.assign(length + 1, 0);
 		/*
 		** run dynamic programming to find the max-weight split
 		** best_scores[i] = maximum score of prefix text[0..(i-1)], i.e first i characters
@@ -597,19 +760,19 @@ public:
 				}
 
 				Token last_token = ranges.back();
-				if (last_token.seg_type == T::URL_SEG_TYPE && !nontone_pair_freq_map.empty())
+				if (last_token.seg_type == T::URL_SEG_TYPE && !dictionary->nontone_pair_scores.empty())
 				{
 					// sticky tokenization on URL parts
-					std::vector< int > sub_space_positions;
+					std::vector< int > &sub_space_positions = workspace.sub_space_positions;
+					sub_space_positions.clear();
 					tokenize_pure_sticky_to_syllables(text + last_token.normalized_start,
 						last_token.normalized_end - last_token.normalized_start,
-						sub_space_positions);
+						sub_space_positions,
+						workspace);
 					if (!sub_space_positions.empty())
 					{
-						std::vector< uint32_t > subtext;
-						subtext.reserve(last_token.normalized_end -
-								last_token.normalized_start +
-								(int) sub_space_positions.size());
+						std::vector< uint32_t > &subtext = workspace.subtext;
+						subtext.clear();
 						for (int pos = last_token.normalized_start, it = 0;
 							pos < last_token.normalized_end;
 							++pos)
@@ -624,22 +787,27 @@ public:
 							subtext.push_back(text[pos]);
 						}
 
-						std::vector< T > subranges;
+						std::vector< Token > &subranges = workspace.subranges;
+						subranges.clear();
 						// this is hacky, we must ensure that space_positions param
 						// passed to run_tokenize cannot be modified
-						run_tokenize< T >(subtext.data(),
+						run_tokenize< Token >(subtext.data(),
 							subtext.size(),
 							subranges,
 							sub_space_positions,
 							false,
-							false);
+							false,
+							true,
+							workspace);
 						ranges.pop_back();
 						for (int range_id = (int) subranges.size() - 1,
 							 it = (int) sub_space_positions.size() - 1;
 							range_id >= 0;
 							--range_id)
 						{
-							ranges.push_back(subranges[range_id]);
+							ranges.push_back(T(subranges[range_id].normalized_start,
+								subranges[range_id].normalized_end));
+							ranges.back().type = subranges[range_id].type;
 							ranges.back().seg_type = last_token.seg_type;
 							while (it >= 0 &&
 								sub_space_positions[it] + it >=
@@ -671,75 +839,93 @@ public:
 				--i;
 			}
 		}
+	}
 
-		// Now ranges store tokens in reverse order (from end to begin of the text)
-		if (keep_puncts)
+	// whether token following an URL-related token is still a part of the same URL
+	static bool continues_url(const uint32_t *text, const Token &token)
+	{
+		return token.is_url_related() ||
+		       (token.seg_type == Token::SKIP_SEG_TYPE && text[token.normalized_start - 1] == '.');
+	}
+
+	/*
+	** add PUNCTs (and SPACEs when for_transforming) between tokens, ranges must be in text order
+	** done in place: count the output first, then move tokens from the back, so that
+	** no temporary vector is needed
+	*/
+	template < class T >
+	void insert_puncts(uint32_t *text, int length, std::vector< T > &ranges, bool for_transforming)
+	{
+		// shouldn't push PUNCTS between URL-parts
+		auto continues_url = [text](const T &token)
 		{
-			// push back the tokens and puncts in reverse order
-			int sum_length = 0;
-			for (T &it : ranges)
+			return Tokenizer::continues_url(text, token);
+		};
+		auto count_puncts = [text, for_transforming](int from, int to)
+		{
+			int count = 0;
+			for (int pos = from; pos < to; ++pos)
 			{
-				sum_length += it.normalized_end - it.normalized_start;
+				if (for_transforming || text[pos] != ' ') count++;
 			}
-			std::vector< T > temp;
-			temp.swap(ranges);
-			ranges.reserve(length - sum_length + temp.size());
-			int last_pos = 0;
-			bool inside_url = false;
-			while (!temp.empty())
+			return count;
+		};
+
+		int token_count = ranges.size();
+		int total_count = token_count;
+		int last_pos = 0;
+		bool inside_url = false;
+		for (int i = 0; i < token_count; ++i)
+		{
+			if (!(inside_url && continues_url(ranges[i])))
 			{
-				// shouldn't push PUNCTS between URL-parts
-				if (!(inside_url && (temp.back().is_url_related() ||
-							    (temp.back().seg_type == T::SKIP_SEG_TYPE &&
-								    text[temp.back().normalized_start - 1] == '.'))))
-				{
-					while (last_pos < temp.back().normalized_start)
-					{
-						if (for_transforming || text[last_pos] != ' ')
-						{
-							ranges.push_back({last_pos, last_pos + 1});
-							ranges.back().type =
-								text[last_pos] == ' ' ? T::SPACE : T::PUNCT;
-						}
-						last_pos++;
-					}
-				}
-				ranges.push_back(temp.back());
-				if (for_transforming)
+				total_count += count_puncts(last_pos, ranges[i].normalized_start);
+			}
+			last_pos = ranges[i].normalized_end;
+			inside_url = ranges[i].is_url_related();
+		}
+		// PUNCTs at the end of the text
+		total_count += count_puncts(last_pos, length);
+		ranges.resize(total_count, T(0, 0));
+
+		auto fill_puncts = [text, for_transforming, &ranges](int from, int to, int &write_pos)
+		{
+			for (int pos = to - 1; pos >= from; --pos)
+			{
+				if (for_transforming || text[pos] != ' ')
 				{
-					// convention from CompositeTokenizer. convert SPACE to UNDERSCORE, convert
-					// UNDERSCORE in special_terms to '~'
-					for (int i = temp.back().normalized_start; i < temp.back().normalized_end; ++i)
-					{
-						if (text[i] == '_') text[i] = '~';
-						if (text[i] == ' ') text[i] = '_';
-					}
+					T &punct = ranges[--write_pos];
+					punct = T(pos, pos + 1);
+					punct.type = text[pos] == ' ' ? T::SPACE : T::PUNCT;
 				}
-				last_pos = temp.back().normalized_end;
-				inside_url = temp.back().is_url_related();
-				temp.pop_back();
 			}
-			// PUNCTs at the end of the text
-			while (last_pos < length)
+		};
+
+		int write_pos = total_count;
+		int next_start = length;
+		bool next_continues_url = false;
+		for (int i = token_count - 1; i >= 0; --i)
+		{
+			// write_pos > i holds all along, so ranges[i] is never overwritten before it is read
+			if (!next_continues_url)
+			{
+				fill_puncts(ranges[i].normalized_end, next_start, write_pos);
+			}
+			next_start = ranges[i].normalized_start;
+			next_continues_url = i > 0 && ranges[i - 1].is_url_related() && continues_url(ranges[i]);
+			if (for_transforming)
 			{
-				if (for_transforming || text[last_pos] != ' ')
+				// convention from CompositeTokenizer. convert SPACE to UNDERSCORE, convert
+				// UNDERSCORE in special_terms to '~'
+				for (int pos = ranges[i].normalized_start; pos < ranges[i].normalized_end; ++pos)
 				{
-					ranges.push_back({last_pos, last_pos + 1});
-					ranges.back().type = text[last_pos] == ' ' ? T::SPACE : T::PUNCT;
+					if (text[pos] == '_') text[pos] = '~';
+					if (text[pos] == ' ') text[pos] = '_';
 				}
-				last_pos++;
 			}
-			// some spaces may be left out, so reserved length may be longer than actual length.
-			ranges.shrink_to_fit();
-		}
-		else
-		{
-			std::reverse(ranges.begin(), ranges.end());
-		}
-		if (tokenize_sticky)
-		{
-			std::reverse(space_positions.begin(), space_positions.end());
+			if (--write_pos != i) ranges[write_pos] = std::move(ranges[i]);
 		}
+		fill_puncts(0, next_start, write_pos);
 	}
 
 	/*
@@ -749,11 +935,47 @@ public:
 	** used as a subroutine for more general methods
 	*/
 	void tokenize_pure_sticky_to_syllables(const uint32_t *text, int length, std::vector< int > &space_positions)
+	{
+		tokenize_pure_sticky_to_syllables(text, length, space_positions, thread_workspace());
+	}
+
+	/*
+	** positions (relative to text) where spaces split the alphanumeric run text into syllables are
+	** appended to space_positions, from the sticky cache when it is enabled and has the run
+	*/
+	void tokenize_pure_sticky_to_syllables(
+		const uint32_t *text, int length, std::vector< int > &space_positions, TokenizerWorkspace &workspace)
 	{
 		if (!text || length <= 0) return;
+		if (!sticky_cache || length > STICKY_CACHE_MAX_LENGTH)
+		{
+			run_tokenize_pure_sticky(text, length, space_positions, workspace);
+			return;
+		}
+
+		std::vector< uint32_t > &key = workspace.sticky_key;
+		std::vector< int > &cached = workspace.sticky_positions;
+		key.assign(text, text + length);
+		if (sticky_cache->find(key, cached))
+		{
+			space_positions.insert(space_positions.end(), cached.begin(), cached.end());
+			return;
+		}
+		size_t begin = space_positions.size();
+		run_tokenize_pure_sticky(text, length, space_positions, workspace);
+		cached.assign(space_positions.begin() + begin, space_positions.end());
+		sticky_cache->insert(key, cached);
+	}
 
+	// the dynamic programming behind tokenize_pure_sticky_to_syllables()
+	void run_tokenize_pure_sticky(
+		const uint32_t *text, int length, std::vector< int > &space_positions, TokenizerWorkspace &workspace)
+	{
 		static const int MAX_TOKEN_LENGTH = 25;
+		static const int ROW_SIZE = MAX_TOKEN_LENGTH + 1;
 
+		const SyllableDATrie &syllable_trie = dictionary->syllable_trie;
+		const CSRMatrix &nontone_pair_scores = dictionary->nontone_pair_scores;
 		int space_positions_begin_size = space_positions.size();
 
 		/*
@@ -762,78 +984,80 @@ public:
 		** with j is the length of the last token (ending at i-1)
 		** trace[i][j] = length of the second last token (length of the last token is obviously j, so no need to
 		*trace that)
+		** all three tables live in one (length + 1) x ROW_SIZE array of cells, cell(i, j) is at i * ROW_SIZE + j
+		** lengths j reachable at i are exactly those with trace[i][j] >= 0 (only j = 0 when i = 0),
+		** they are visited from longest to shortest, the order in which they were first reached
 		*/
-		std::vector< std::vector< double > > best_scores(length + 1, std::vector< double >());
-		std::vector< std::vector< int > > all_token_lengths(length + 1, std::vector< int >());
-		std::vector< std::vector< int > > trace(length + 1, std::vector< int >());
-		std::vector< std::vector< trie_node_t > > syll_node(length + 1, std::vector< trie_node_t >());
+		typedef TokenizerWorkspace::StickyCell Cell;
+		std::vector< Cell > &cells = workspace.sticky_cells;
+		Cell empty_cell = {-1, -1, -1};
+		cells.assign((size_t) (length + 1) * ROW_SIZE, empty_cell);
+		cells[0].best_score = 0;
 
-		for (int i = 0; i <= length; ++i)
-		{
-			best_scores[i].assign(std::min(MAX_TOKEN_LENGTH, i) + 1, -1);
-			trace[i].assign(best_scores[i].size(), -1);
-			syll_node[i].assign(best_scores[i].size(), -1);
-		}
-
-		best_scores[0][0] = 0;
-		all_token_lengths[0].push_back(0);
 		for (int i = 0; i < length; ++i)
 		{
-			if (!all_token_lengths[i].empty())
+			Cell *row = &cells[(size_t) i * ROW_SIZE];
+			int max_last_length = std::min(MAX_TOKEN_LENGTH, i);
+			int last_token_length = max_last_length;
+			if (i > 0)
 			{
-				trie_node_t next_node = 0;
-				for (int j = i; j < i + MAX_TOKEN_LENGTH && j < length; ++j)
+				while (last_token_length > 0 && row[last_token_length].trace < 0)
 				{
-					if (!syllable_trie.has_child(next_node, text[j])) break;
-					syll_node[j + 1][j - i + 1] = next_node =
-						syllable_trie.get_child(next_node, text[j]);
+					last_token_length--;
 				}
+				if (last_token_length == 0) continue;
 			}
 
-			for (int last_token_length : all_token_lengths[i])
+			int max_j = std::min(i + MAX_TOKEN_LENGTH, length);
+			trie_node_t next_node = 0;
+			for (int j = i; j < max_j; ++j)
 			{
-				trie_node_t last_node = syll_node[i][last_token_length];
-				for (int j = i; j < i + MAX_TOKEN_LENGTH && j < length; ++j)
+				next_node = syllable_trie.try_child(next_node, text[j]);
+				if (next_node == -1) break;
+				cells[(size_t) (j + 1) * ROW_SIZE + j - i + 1].syll_node = next_node;
+			}
+
+			for (; last_token_length >= 0; --last_token_length)
+			{
+				if (i > 0 && row[last_token_length].trace < 0) continue;
+				trie_node_t last_node = row[last_token_length].syll_node;
+				int last_index = ~last_node ? syllable_trie.get_index(last_node) : -1;
+				double last_score = row[last_token_length].best_score;
+				for (int j = i; j < max_j; ++j)
 				{
 					int self_len = j - i + 1;
-					trie_node_t next_node = syll_node[j + 1][self_len];
+					Cell &cell = cells[(size_t) (j + 1) * ROW_SIZE + self_len];
+					trie_node_t next_node = cell.syll_node;
 					if (next_node == -1) break;
 
 					double cur_score = syllable_trie.get_weight(next_node);
-					if ((~last_node) && (~syllable_trie.get_index(last_node)) &&
-						(~syllable_trie.get_index(next_node)))
+					int next_index = syllable_trie.get_index(next_node);
+					if ((~last_index) && (~next_index))
 					{
-						auto it =
-							nontone_pair_freq_map[syllable_trie.get_index(last_node)].find(
-								syllable_trie.get_index(next_node));
-						if (it !=
-							nontone_pair_freq_map[syllable_trie.get_index(last_node)].end())
+						const float *pair_score = nontone_pair_scores.find(last_index, next_index);
+						if (pair_score != nullptr)
 						{
-							cur_score += it->second;
+							cur_score += *pair_score;
 						}
 					}
 
-					double total_score = best_scores[i][last_token_length] + cur_score;
-					if (best_scores[j + 1][self_len] < total_score)
+					double total_score = last_score + cur_score;
+					if (cell.best_score < total_score)
 					{
-						best_scores[j + 1][self_len] = total_score;
-						trace[j + 1][self_len] = last_token_length;
-						if (all_token_lengths[j + 1].empty() ||
-							all_token_lengths[j + 1].back() != self_len)
-						{
-							all_token_lengths[j + 1].push_back(self_len);
-						}
+						cell.best_score = total_score;
+						cell.trace = last_token_length;
 					}
 				}
 			}
 		}
 
+		const Cell *last_row = &cells[(size_t) length * ROW_SIZE];
 		int last_token_length = 0;
-		for (int j = 1; j < (int) best_scores[length].size(); ++j)
+		for (int j = 1; j <= std::min(MAX_TOKEN_LENGTH, length); ++j)
 		{
-			if (trace[length][j] >= 0)
+			if (last_row[j].trace >= 0)
 			{
-				if (best_scores[length][last_token_length] < best_scores[length][j])
+				if (last_row[last_token_length].best_score < last_row[j].best_score)
 				{
 					last_token_length = j;
 				}
@@ -841,7 +1065,8 @@ public:
 		}
 		for (int i = length, j = last_token_length; i > 0;)
 		{
-			if (trace[i][j] >= 0)
+			const Cell &cell = cells[(size_t) i * ROW_SIZE + j];
+			if (cell.trace >= 0)
 			{
 				int new_i = i - j;
 				if (new_i)
@@ -852,7 +1077,7 @@ public:
 						space_positions.push_back(new_i);
 					}
 				}
-				j = trace[i][j];
+				j = cell.trace;
 				i = new_i;
 			}
 			else
@@ -901,6 +1126,17 @@ public:
 		std::vector< int > &original_pos,
 		bool for_transforming)
 	{
+		run_tokenize_url< T >(text, ranges, space_positions, original_pos, for_transforming, thread_workspace());
+	}
+
+	template < class T >
+	void run_tokenize_url(std::vector< uint32_t > &text,
+		std::vector< T > &ranges,
+		std::vector< int > &space_positions,
+		std::vector< int > &original_pos,
+		bool for_transforming,
+		TokenizerWorkspace &workspace)
+	{
 
 		int start_index = 0;
 		if (Helper::vector_match_string(text, "http"))
@@ -915,15 +1151,18 @@ public:
 			}
 		}
 
-		std::vector< uint32_t > new_text;
-		std::vector< int > new_original_pos;
+		// text and original_pos are swapped with these at the end, both keep their capacity
+		std::vector< uint32_t > &new_text = workspace.url_text;
+		std::vector< int > &new_original_pos = workspace.url_original_pos;
+		new_text.clear();
+		new_original_pos.clear();
 
-		auto push = [&text, &new_text, &space_positions, &original_pos, &new_original_pos, this](
+		auto push = [&text, &new_text, &space_positions, &original_pos, &new_original_pos, &workspace, this](
 			int from, int to)
 		{
 			int sublength = to - from;
 			size_t it = space_positions.size();
-			tokenize_pure_sticky_to_syllables(text.data() + from, sublength, space_positions);
+			tokenize_pure_sticky_to_syllables(text.data() + from, sublength, space_positions, workspace);
 			for (int pos = 0; pos < sublength; ++pos)
 			{
 				if (it < space_positions.size() && pos == space_positions[it])
@@ -968,7 +1207,7 @@ public:
 		text.swap(new_text);
 		original_pos.swap(new_original_pos);
 		run_tokenize< T >(
-			text.data(), text.size(), ranges, space_positions, for_transforming, false, false);
+			text.data(), text.size(), ranges, space_positions, for_transforming, false, false, workspace);
 	}
 
 	template < class T >
@@ -1037,20 +1276,50 @@ public:
 		int tokenize_option,
 		bool keep_puncts)
 	{
+		handle_tokenization_request(text,
+			ranges,
+			space_positions,
+			original_pos,
+			for_transforming,
+			tokenize_option,
+			keep_puncts,
+			thread_workspace());
+	}
+
+	/*
+	** compositor
+	** all scratch buffers come from workspace, ranges & space_positions are appended to
+	*/
+	template < class T >
+	void handle_tokenization_request(std::vector< uint32_t > &text,
+		std::vector< T > &ranges,
+		std::vector< int > &space_positions,
+		std::vector< int > &original_pos,
+		bool for_transforming,
+		int tokenize_option,
+		bool keep_puncts,
+		TokenizerWorkspace &workspace)
+	{
 
 		if (tokenize_option == TOKENIZE_NORMAL)
 		{
-			Tokenizer::instance().run_tokenize< T >(
-				text.data(), text.size(), ranges, space_positions, for_transforming, true, keep_puncts);
+			run_tokenize< T >(text.data(),
+				text.size(),
+				ranges,
+				space_positions,
+				for_transforming,
+				true,
+				keep_puncts,
+				workspace);
 		}
 		else if (tokenize_option == TOKENIZE_HOST)
 		{
-			Tokenizer::instance().run_tokenize_host< T >(text, ranges, original_pos);
+			run_tokenize_host< T >(text, ranges, original_pos);
 		}
 		else if (tokenize_option == TOKENIZE_URL)
 		{
-			Tokenizer::instance().run_tokenize_url< T >(
-				text, ranges, space_positions, original_pos, for_transforming);
+			run_tokenize_url< T >(
+				text, ranges, space_positions, original_pos, for_transforming, workspace);
 		}
 		else
 		{
@@ -1081,15 +1350,47 @@ public:
 	std::vector< FullToken > segment(
 		const std::string &original_text, bool for_transforming, int tokenize_option, bool keep_puncts)
 	{
-		std::vector< uint32_t > text;
-		std::vector< int > original_pos;
-		normalize_for_tokenization(original_text, text, original_pos);
-
 		std::vector< FullToken > res;
-		std::vector< int > space_positions;
+		segment(original_text, for_transforming, tokenize_option, keep_puncts, res, thread_workspace());
+		return res;
+	}
 
-		handle_tokenization_request< FullToken >(
-			text, res, space_positions, original_pos, for_transforming, tokenize_option, keep_puncts);
+	/*
+	** wrapper function
+	** res is overwritten, reusing both res and workspace across calls avoids heap allocations
+	** except for the token texts
+	*/
+	void segment(const std::string &original_text,
+		bool for_transforming,
+		int tokenize_option,
+		bool keep_puncts,
+		std::vector< FullToken > &res,
+		TokenizerWorkspace &workspace)
+	{
+		std::string *query_key = nullptr;
+		if (query_cache && original_text.size() <= QUERY_CACHE_MAX_LENGTH)
+		{
+			// the options go into one byte after the text
+			query_key = &workspace.query_key;
+			query_key->assign(original_text);
+			*query_key += (char) ((tokenize_option << 2) | (for_transforming << 1) | keep_puncts);
+			if (query_cache->find(*query_key, res)) return;
+		}
+
+		normalize_to_workspace(original_text, workspace);
+		std::vector< uint32_t > &text = workspace.text;
+		std::vector< int > &original_pos = workspace.original_pos;
+		std::vector< int > &space_positions = workspace.space_positions;
+
+		res.clear();
+		handle_tokenization_request< FullToken >(text,
+			res,
+			space_positions,
+			original_pos,
+			for_transforming,
+			tokenize_option,
+			keep_puncts,
+			workspace);
 
 		if (tokenize_option == TOKENIZE_URL) space_positions.clear(); // space_positions is not necessary for normalized text
 
@@ -1099,32 +1400,233 @@ public:
 			res[i].original_start += original_pos[res[i].normalized_start];
 			res[i].original_end += original_pos[res[i].normalized_end];
 			res[i].text.reserve(res[i].original_end - res[i].original_start + 1);
-			for (int pos = res[i].normalized_start; pos < res[i].normalized_end; ++pos)
+			append_token_text(text, space_positions, res[i], for_transforming, it, res[i].text);
+		}
+		if (query_key) query_cache->insert(*query_key, res);
+	}
+
+	/*
+	** same tokens as segment(), but the texts of all tokens share one buffer, see SegmentedText
+	** res is overwritten, reusing both res and workspace across calls avoids heap allocations entirely
+	*/
+	void segment(const std::string &original_text,
+		bool for_transforming,
+		int tokenize_option,
+		bool keep_puncts,
+		SegmentedText &res,
+		TokenizerWorkspace &workspace)
+	{
+		normalize_to_workspace(original_text, workspace);
+		std::vector< uint32_t > &text = workspace.text;
+		std::vector< int > &original_pos = workspace.original_pos;
+		std::vector< int > &space_positions = workspace.space_positions;
+
+		res.clear();
+		handle_tokenization_request< Token >(text,
+			res.tokens,
+			space_positions,
+			original_pos,
+			for_transforming,
+			tokenize_option,
+			keep_puncts,
+			workspace);
+
+		if (tokenize_option == TOKENIZE_URL) space_positions.clear(); // space_positions is not necessary for normalized text
+
+		space_positions.push_back(-1);
+		res.normalized.reserve(original_text.size() + space_positions.size());
+		res.text_offsets.reserve(res.tokens.size() + 1);
+		res.text_offsets.push_back(0);
+		for (int i = 0, it = 0; i < (int) res.tokens.size(); ++i)
+		{
+			Token &token = res.tokens[i];
+			token.original_start += original_pos[token.normalized_start];
+			token.original_end += original_pos[token.normalized_end];
+			append_token_text(text, space_positions, token, for_transforming, it, res.normalized);
+			res.text_offsets.push_back(res.normalized.size());
+		}
+	}
+
+	/*
+	** wrapper function
+	** uses the workspace of the calling thread
+	*/
+	void segment(const std::string &original_text,
+		bool for_transforming,
+		int tokenize_option,
+		bool keep_puncts,
+		SegmentedText &res)
+	{
+		segment(original_text, for_transforming, tokenize_option, keep_puncts, res, thread_workspace());
+	}
+
+	/*
+	** tokenize original_text and call visitor(original_start, original_end, type, seg_type) for every token
+	** in text order, offsets are in bytes of original_text, tokens are the same segment() gives
+	** the DP trace is kept in a workspace buffer (visit_ranges) reused across calls and walked backwards,
+	** so there is no per-call vector, no std::reverse and no insert_puncts() pass
+	** visitor must not tokenize with the same workspace
+	*/
+	template < class Visitor >
+	void tokenize(const std::string &original_text,
+		bool for_transforming,
+		int tokenize_option,
+		bool keep_puncts,
+		Visitor &&visitor,
+		TokenizerWorkspace &workspace)
+	{
+		normalize_to_workspace(original_text, workspace);
+		std::vector< uint32_t > &text = workspace.text;
+		std::vector< int > &original_pos = workspace.original_pos;
+		std::vector< Token > &ranges = workspace.visit_ranges;
+		ranges.clear();
+
+		if (tokenize_option != TOKENIZE_NORMAL)
+		{
+			// URL and host modes rewrite the text and never add PUNCTs, their tokens are few and in order
+			handle_tokenization_request< Token >(text,
+				ranges,
+				workspace.space_positions,
+				original_pos,
+				for_transforming,
+				tokenize_option,
+				keep_puncts,
+				workspace);
+			for (const Token &token : ranges)
 			{
-				if (space_positions[it] == pos)
+				visitor(original_pos[token.normalized_start],
+					original_pos[token.normalized_end],
+					token.type,
+					token.seg_type);
+			}
+			return;
+		}
+
+		const uint32_t *data = text.data();
+		int length = text.size();
+		run_tokenize_reversed(text.data(), length, ranges, workspace.space_positions, true, workspace);
+
+		// same PUNCTs as insert_puncts()
+		auto visit_puncts = [&](int from, int to)
+		{
+			if (!keep_puncts) return;
+			for (int pos = from; pos < to; ++pos)
+			{
+				if (for_transforming || data[pos] != ' ')
 				{
-					res[i].text += (for_transforming ? '_' : ' ');
-					it++;
+					visitor(original_pos[pos],
+						original_pos[pos + 1],
+						data[pos] == ' ' ? Token::SPACE : Token::PUNCT,
+						Token::OTHER_SEG_TYPE);
 				}
-				utf8::append(text[pos], std::back_inserter(res[i].text));
 			}
+		};
+
+		int last_pos = 0;
+		bool inside_url = false;
+		for (int i = (int) ranges.size() - 1; i >= 0; --i)
+		{
+			const Token &token = ranges[i];
+			if (!(inside_url && continues_url(data, token)))
+			{
+				visit_puncts(last_pos, token.normalized_start);
+			}
+			visitor(original_pos[token.normalized_start],
+				original_pos[token.normalized_end],
+				token.type,
+				token.seg_type);
+			last_pos = token.normalized_end;
+			inside_url = token.is_url_related();
 		}
+		visit_puncts(last_pos, length);
+	}
+
+	/*
+	** wrapper function
+	** uses the workspace of the calling thread, so visitor must not tokenize on the same thread
+	** unless it passes its own workspace
+	*/
+	template < class Visitor >
+	void tokenize(
+		const std::string &original_text, bool for_transforming, int tokenize_option, bool keep_puncts, Visitor &&visitor)
+	{
+		tokenize(original_text,
+			for_transforming,
+			tokenize_option,
+			keep_puncts,
+			std::forward< Visitor >(visitor),
+			thread_workspace());
+	}
+
+	/*
+	** tokenize a batch of texts in parallel, results are in input order
+	** the tokens of every text are those segment() gives for it, keep_puncts defaults to for_transforming
+	** runs on batch_pool(), n_threads <= 0 uses all of its workers, batches from different threads are run one after another
+	** a batch started from inside a task of batch_pool() runs inline on that thread (see WorkStealingPool::parallel_for())
+	*/
+	std::vector< std::vector< FullToken > > segment_batch(const std::vector< std::string > &texts,
+		bool for_transforming = false,
+		int tokenize_option = TOKENIZE_NORMAL)
+	{
+		return segment_batch(texts, batch_pool(), for_transforming, tokenize_option, for_transforming);
+	}
+
+	std::vector< std::vector< FullToken > > segment_batch(const std::vector< std::string > &texts,
+		bool for_transforming,
+		int tokenize_option,
+		bool keep_puncts,
+		int n_threads = 0)
+	{
+		return segment_batch(texts, batch_pool(), for_transforming, tokenize_option, keep_puncts, n_threads);
+	}
+
+	/*
+	** same as above on a caller-owned pool
+	** each worker thread tokenizes with its own thread_workspace(), so the scratch buffers
+	** are reused across all texts of the batch and across batches
+	*/
+	std::vector< std::vector< FullToken > > segment_batch(const std::vector< std::string > &texts,
+		WorkStealingPool &pool,
+		bool for_transforming = false,
+		int tokenize_option = TOKENIZE_NORMAL)
+	{
+		return segment_batch(texts, pool, for_transforming, tokenize_option, for_transforming);
+	}
 
+	std::vector< std::vector< FullToken > > segment_batch(const std::vector< std::string > &texts,
+		WorkStealingPool &pool,
+		bool for_transforming,
+		int tokenize_option,
+		bool keep_puncts,
+		int n_threads = 0)
+	{
+		std::vector< std::vector< FullToken > > res(texts.size());
+		pool.parallel_for(texts.size(),
+			[this, &texts, &res, for_transforming, tokenize_option, keep_puncts](int, size_t index)
+			{
+				segment(texts[index],
+					for_transforming,
+					tokenize_option,
+					keep_puncts,
+					res[index],
+					thread_workspace());
+			},
+			n_threads);
 		return res;
 	}
 
 	std::vector< FullToken > segment_original(
 		const std::string &original_text, int tokenize_option = TOKENIZE_NORMAL)
 	{
-		std::vector< uint32_t > text;
-		std::vector< int > original_pos;
-		normalize_for_tokenization(original_text, text, original_pos);
+		TokenizerWorkspace &workspace = thread_workspace();
+		normalize_to_workspace(original_text, workspace);
+		std::vector< uint32_t > &text = workspace.text;
+		std::vector< int > &original_pos = workspace.original_pos;
+		std::vector< int > &space_positions = workspace.space_positions;
 
 		std::vector< FullToken > res;
-		std::vector< int > space_positions;
-
 		handle_tokenization_request< FullToken >(
-			text, res, space_positions, original_pos, false, tokenize_option);
+			text, res, space_positions, original_pos, false, tokenize_option, false, workspace);
 
 		for (int &pos : space_positions) pos = original_pos[pos];
 		space_positions.push_back(-1);
@@ -1152,11 +1654,11 @@ public:
 
 	std::string segment_sticky_to_string(const std::string &original_text)
 	{
-		std::vector< uint32_t > text;
-		std::vector< int > original_pos;
-		normalize_for_tokenization(original_text, text, original_pos);
-		std::vector< int > space_positions;
-		Tokenizer::instance().tokenize_sticky_to_syllables(text, space_positions);
+		TokenizerWorkspace &workspace = thread_workspace();
+		normalize_to_workspace(original_text, workspace);
+		std::vector< uint32_t > &text = workspace.text;
+		std::vector< int > &space_positions = workspace.space_positions;
+		tokenize_sticky_to_syllables(text, space_positions);
 
 		std::string res_str;
 		int it = 0;
@@ -1180,26 +1682,41 @@ public:
 		return res_str;
 	}
 
-	// warning: this function is slower than segment(), since strings are copied to new vector
+	// warning: this function is slower than segment() with SegmentedText, since every token gets its own string
 	std::vector< std::string > segment_to_string_list(
 		const std::string &text, bool for_transforming = false, int tokenize_option = TOKENIZE_NORMAL)
 	{
-		std::vector< FullToken > full_res = segment(text, for_transforming, tokenize_option);
-		return to_string_list(full_res);
+		return to_string_list(segment(text, for_transforming, tokenize_option));
 	}
 
 	// reimplement of segment_original for general purpose (python wrapping)
 	std::vector< FullToken > segment_general(const std::string &original_text, int tokenize_option = TOKENIZE_NORMAL) {
-		std::vector< uint32_t > text;
-		std::vector< int > original_pos;
-		normalize_for_tokenization(original_text, text, original_pos);
-
 		std::vector< FullToken > res;
-		std::vector< int > space_positions;
+		segment_general(original_text, tokenize_option, res, thread_workspace());
+		return res;
+	}
+
+	// res is overwritten
+	void segment_general(const std::string &original_text,
+		int tokenize_option,
+		std::vector< FullToken > &res,
+		TokenizerWorkspace &workspace)
+	{
+		normalize_to_workspace(original_text, workspace);
+		std::vector< uint32_t > &text = workspace.text;
+		std::vector< int > &original_pos = workspace.original_pos;
+		std::vector< int > &space_positions = workspace.space_positions;
 
+		res.clear();
 		// using for_transforming to keep punctuations
-		handle_tokenization_request< FullToken >(
-			text, res, space_positions, original_pos, /*for_transforming*/ true, tokenize_option);
+		handle_tokenization_request< FullToken >(text,
+			res,
+			space_positions,
+			original_pos,
+			/*for_transforming*/ true,
+			tokenize_option,
+			/*keep_puncts*/ true,
+			workspace);
 
 		for (int &pos : space_positions) pos = original_pos[pos];
 		space_positions.push_back(-1);
@@ -1226,7 +1743,22 @@ public:
 		res.erase(std::remove_if(res.begin(), res.end(), 
 								 [&](const FullToken &token) {return (token.text == "_");}),
 				  res.end());
+	}
 
+	/*
+	** segment_general() for a batch of texts on batch_pool(), results are in input order
+	** n_threads <= 0 uses all workers of the pool
+	*/
+	std::vector< std::vector< FullToken > > segment_general_batch(
+		const std::vector< std::string > &texts, int tokenize_option = TOKENIZE_NORMAL, int n_threads = 0)
+	{
+		std::vector< std::vector< FullToken > > res(texts.size());
+		batch_pool().parallel_for(texts.size(),
+			[this, &texts, &res, tokenize_option](int, size_t index)
+			{
+				segment_general(texts[index], tokenize_option, res[index], thread_workspace());
+			},
+			n_threads);
 		return res;
 	}
 
@@ -0,0 +1,66 @@
+#ifndef TOKENIZER_WORKSPACE_HPP
+#define TOKENIZER_WORKSPACE_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "token.hpp"
+
+/*
+** Scratch buffers for tokenization calls
+** Buffers are only cleared and never shrunk, so once a workspace has seen inputs of some length,
+** tokenizing inputs up to that length does not touch the heap anymore
+** A workspace must not be used by two threads at the same time
+*/
+struct TokenizerWorkspace
+{
+	// dynamic programming in run_tokenize()
+	struct SplitBuffers
+	{
+		std::vector< double > best_scores;
+		std::vector< int > trace;
+		std::vector< char > is_special;
+	};
+	// sticky URL parts are re-tokenized (with tokenize_sticky = false) while the trace
+	// of the outer call is still in use, so each of them gets its own set
+	SplitBuffers split[2];
+
+	// sticky URL parts in run_tokenize()
+	std::vector< int > sub_space_positions;
+	std::vector< uint32_t > subtext;
+	std::vector< Token > subranges;
+
+	// sticky-text DP in tokenize_pure_sticky_to_syllables(), one row of cells per prefix length
+	struct StickyCell
+	{
+		double best_score;
+		int trace;
+		int syll_node;
+	};
+	std::vector< StickyCell > sticky_cells;
+	// key and result of a sticky cache lookup
+	std::vector< uint32_t > sticky_key;
+	std::vector< int > sticky_positions;
+
+	// run_tokenize_url()
+	std::vector< uint32_t > url_text;
+	std::vector< int > url_original_pos;
+
+	// tokens in tokenize() with a visitor
+	std::vector< Token > visit_ranges;
+
+	// key of a query cache lookup in segment()
+	std::string query_key;
+
+	// segment() and friends
+	std::vector< uint32_t > text;
+	std::vector< int > original_pos;
+	std::vector< int > space_positions;
+
+	SplitBuffers &split_buffers(bool tokenize_sticky)
+	{
+		return split[tokenize_sticky ? 0 : 1];
+	}
+};
+
+#endif // TOKENIZER_WORKSPACE_HPP
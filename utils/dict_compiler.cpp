@@ -3,15 +3,14 @@
 #include <stdio.h>
 #include <vector>
 #include <string>
+#include <iterator>
 #include <tokenizer/config.h>
 #include "auxiliary/vn_lang_tool.hpp"
 #include "auxiliary/trie.hpp"
-#include "auxiliary/sparsepp/spp.h"
-#include "auxiliary/file_serializer.hpp"
+#include "auxiliary/csr_matrix.hpp"
+#include "auxiliary/dict_bundle.hpp"
 #include "auxiliary/buffered_reader.hpp"
 
-typedef spp::sparse_hash_map< int, float > fast_map_t;
-
 namespace Helper
 {
 bool is_digit(char c)
@@ -137,14 +136,6 @@ int load_and_dump_nontone_pairs(
 	// nontone_pair_freq is encoded in a way that reduce file size (and potentially improve reading time)
 	// It can be compressed in another form (for example gzip) if we need to reduce file size further
 
-	FILE *out_file = fopen(out_path.c_str(), "wb");
-	if (out_file == nullptr)
-	{
-		std::cerr << "Error: cannot open " << out_path << " for writing" << std::endl;
-		return -1;
-	}
-	FileSerializer serializer;
-
 	BufferedReader reader((dict_path + "/nontone_pair_freq").c_str());
 	int n = reader.next_int(); // number of rows
 	if (n != (int) syllable_length.size())
@@ -153,11 +144,13 @@ int load_and_dump_nontone_pairs(
 		return -1;
 	}
 
-	fwrite(&n, sizeof(n), 1, out_file);
-
+	// Rows are stored one after another in compressed-sparse-row layout,
+	// so the tokenizer can load (or map) the whole matrix at once
+	CSRMatrix pair_scores;
+	std::vector< std::pair< int, float > > cur_row;
 	for (int first_index = 0; first_index < n; ++first_index)
 	{
-		fast_map_t cur_map;
+		cur_row.clear();
 		int n_pairs = reader.next_int(); // Start with number of non-zero elements
 		int second_index = 0;
 		for (int i = 0; i < n_pairs; ++i)
@@ -175,13 +168,12 @@ int load_and_dump_nontone_pairs(
 			float pair_score = pair_sticky_params[0] * std::pow(pair_len, pair_sticky_params[1]) *
 					   std::pow(pair_freq, pair_sticky_params[2]);
 
-			cur_map[second_index] = pair_score;
+			cur_row.push_back(std::make_pair(second_index, pair_score));
 		}
-		cur_map.serialize(serializer, out_file);
+		pair_scores.append_row(cur_row);
 	}
 
-	fclose(out_file);
-	return 0;
+	return pair_scores.dump_to_file(out_path);
 }
 
 int load_keywords(const std::string &dict_path, MultitermHashTrie &multiterm_hashtrie)
@@ -315,6 +307,39 @@ int load_and_compile_all_dicts(const std::string &dict_path, const std::string &
 	return 0;
 }
 
+int read_whole_file(const std::string &file_path, std::string &content)
+{
+	std::ifstream f(file_path.c_str(), std::ios::binary);
+	if (!f.is_open())
+	{
+		std::cerr << "Error openning file, " << file_path << std::endl;
+		return -1;
+	}
+	content.assign(std::istreambuf_iterator< char >(f), std::istreambuf_iterator< char >());
+	return 0;
+}
+
+// pack the compiled dumps and the VnLangTool sources into a single DICT_BUNDLE file
+int write_dict_bundle(const std::string &vn_lang_tool_path, const std::string &out_path)
+{
+	std::pair< uint32_t, std::string > files[] = {
+		{DictBundle::MULTITERM_TRIE, out_path + '/' + MULTITERM_DICT_DUMP},
+		{DictBundle::SYLLABLE_TRIE, out_path + '/' + SYLLABLE_DICT_DUMP},
+		{DictBundle::NONTONE_PAIR_SCORES, out_path + '/' + NONTONE_PAIR_DICT_DUMP},
+		{DictBundle::VN_ALPHABETIC, vn_lang_tool_path + "/alphabetic"},
+		{DictBundle::VN_NUMERIC, vn_lang_tool_path + "/numeric"},
+		{DictBundle::VN_D_AND_GI, vn_lang_tool_path + "/d_and_gi.txt"},
+		{DictBundle::VN_I_AND_Y, vn_lang_tool_path + "/i_and_y.txt"}};
+
+	std::vector< std::pair< uint32_t, std::string > > contents;
+	for (const std::pair< uint32_t, std::string > &file : files)
+	{
+		contents.push_back(std::make_pair(file.first, std::string()));
+		if (0 > read_whole_file(file.second, contents.back().second)) return -1;
+	}
+	return DictBundle::write_to_file(out_path + '/' + DICT_BUNDLE, contents);
+}
+
 int main(int argc, char **argv)
 {
 	if (argc < 3)
@@ -327,5 +352,8 @@ int main(int argc, char **argv)
 		return -1;
 	}
 	if (0 > VnLangTool::init(argv[1] + std::string("/vn_lang_tool"))) return -1;
-	return load_and_compile_all_dicts(argv[1] + std::string("/tokenizer"), argv[2], true);
+	int status_code = 0;
+	if (0 > (status_code = load_and_compile_all_dicts(argv[1] + std::string("/tokenizer"), argv[2], true)))
+		return status_code;
+	return write_dict_bundle(argv[1] + std::string("/vn_lang_tool"), argv[2]);
 }
@@ -1,5 +1,7 @@
 #include <vector>
+#include <cerrno>
 #include <getopt.h>
+#include <unistd.h>
 #include <tokenizer/tokenizer.hpp>
 #include <tokenizer/config.h>
 
@@ -10,18 +12,26 @@
 struct tokenizer_option
 {
 	bool no_sticky;
+	bool use_mmap;
 	int keep_puncts;
 	bool for_transforming;
 	int tokenize_option;
 	int format;
+	int threads;
+	size_t sticky_cache;
+	size_t query_cache;
 	const char *dict_path;
 
 	tokenizer_option()
 	    : no_sticky(false),
+		  use_mmap(false),
 		  keep_puncts(-1),
 		  for_transforming(false),
 	      tokenize_option(Tokenizer::TOKENIZE_NORMAL),
 	      format(FORMAT_TSV),
+	      threads(1),
+	      sticky_cache(0),
+	      query_cache(0),
 	      dict_path(DICT_PATH)
 	{
 	}
@@ -37,6 +47,10 @@ static struct option options[] = {
 	{ "transform"    , no_argument      , NULL, 't' },
 	{ "format"       , required_argument, NULL, 'f' },
 	{ "dict-path"    , required_argument, NULL, 'd' },
+	{ "mmap"         , no_argument      , NULL, 'm' },
+	{ "threads"      , required_argument, NULL, 'j' },
+	{ "sticky-cache" , required_argument, NULL, 'c' },
+	{ "query-cache"  , required_argument, NULL, 'q' },
 	{  NULL          , 0                , NULL,  0  }
 };
 // clang-format on
@@ -55,6 +69,11 @@ int print_tokenizer_usage(int argc, char **argv)
 		"    -t, --transform        : segment for transformation\n"
 		"    -f, --format <format>  : output format (tsv, original, verbose)\n"
 		"    -d, --dict-path <path> : dictionaries path, default is " DICT_PATH "\n"
+		"    -m, --mmap             : map dictionaries read-only instead of loading them\n"
+		"    -j, --threads <N>      : tokenize lines of standard input with N threads, default is 1,\n"
+		"                             0 means one thread per CPU core, output order is kept\n"
+		"    -c, --sticky-cache <N> : cache the sticky segmentation of up to N url parts, default is 0 (off)\n"
+		"    -q, --query-cache <N>  : cache the tokens of up to N distinct lines, default is 0 (off)\n"
 		"        --help             : show this message\n"
 		"\n"
 		"Output formats:\n"
@@ -69,7 +88,7 @@ int print_tokenizer_usage(int argc, char **argv)
 int tokenizer_getopt_parse(int argc, char **argv, tokenizer_option &opts)
 {
 	int option_code;
-	while (~(option_code = getopt_long(argc, argv, "nuhf:d:kt", options, NULL)))
+	while (~(option_code = getopt_long(argc, argv, "nuhf:d:ktmj:c:q:", options, NULL)))
 	{
 		switch (option_code)
 		{
@@ -110,92 +129,211 @@ int tokenizer_getopt_parse(int argc, char **argv, tokenizer_option &opts)
 		case 't':
 			opts.for_transforming = true;
 			break;
+		case 'm':
+			opts.use_mmap = true;
+			break;
+		case 'j':
+			opts.threads = atoi(optarg);
+			if (opts.threads < 0)
+			{
+				fprintf(stderr, "Error: Invalid number of threads '%s'.\n\n", optarg);
+				return -1;
+			}
+			if (opts.threads == 0) opts.threads = std::max(1, (int) std::thread::hardware_concurrency());
+			break;
+		case 'c':
+			if (atoi(optarg) < 0)
+			{
+				fprintf(stderr, "Error: Invalid sticky cache capacity '%s'.\n\n", optarg);
+				return -1;
+			}
+			opts.sticky_cache = atoi(optarg);
+			break;
+		case 'q':
+			if (atoi(optarg) < 0)
+			{
+				fprintf(stderr, "Error: Invalid query cache capacity '%s'.\n\n", optarg);
+				return -1;
+			}
+			opts.query_cache = atoi(optarg);
+			break;
 		default:
 			return -1;
 		}
 	}
 
+	if (opts.keep_puncts == -1)
+	{
+		opts.keep_puncts = opts.for_transforming;
+	}
+
 	return 0;
 }
 
-int main(int argc, char **argv)
+/*
+** tokenize one line and append its output (without the line break) to out
+** tokens is scratch space, reused between calls
+*/
+void format_line(const std::string &text, const tokenizer_option &opts, std::vector< FullToken > &tokens, std::string &out)
 {
-	tokenizer_option opts;
-
-	if (tokenizer_getopt_parse(argc, argv, opts))
+	if (opts.format != FORMAT_ORIGINAL)
 	{
-		print_tokenizer_usage(argc, argv);
-		exit(EXIT_FAILURE);
+		Tokenizer::instance().segment(text,
+			opts.for_transforming,
+			opts.tokenize_option,
+			opts.keep_puncts,
+			tokens,
+			Tokenizer::thread_workspace());
 	}
-
-	if (0 > Tokenizer::instance().initialize(opts.dict_path, !opts.no_sticky))
+	else
 	{
-		exit(EXIT_FAILURE);
+		tokens = Tokenizer::instance().segment_original(text, opts.tokenize_option);
 	}
 
-	auto process = [&opts](const std::string &text)
+	if (opts.format == FORMAT_ORIGINAL)
 	{
-		if (opts.keep_puncts == -1) {
-			opts.keep_puncts = opts.for_transforming;
-		}
-		std::vector< FullToken > res = opts.format != FORMAT_ORIGINAL ?
-			Tokenizer::instance().segment(text, opts.for_transforming, opts.tokenize_option, opts.keep_puncts) :
-			Tokenizer::instance().segment_original(text, opts.tokenize_option);
+		size_t i = 0;
 
-		if (opts.format == FORMAT_ORIGINAL)
+		for (/* void */; i < tokens.size(); ++i)
 		{
-			size_t i = 0;
+			size_t punct_start = (i > 0) ? tokens[i - 1].original_end : 0;
+			size_t punct_len = tokens[i].original_start - punct_start;
 
-			for (/* void */; i < res.size(); ++i)
+			if (punct_len > 0)
 			{
-				size_t punct_start = (i > 0) ? res[i - 1].original_end : 0;
-				size_t punct_len = res[i].original_start - punct_start;
+				out.append(text, punct_start, punct_len);
+			} else if (i > 0) {
+				out += ' '; // avoid having tokens sticked together
+			}
 
-				if (punct_len > 0)
-				{
-					std::cout << text.substr(punct_start, punct_len);
-				} else if (i > 0) {
-					std::cout << ' '; // avoid having tokens sticked together
-				}
+			out += tokens[i].text;
+		}
+
+		size_t punct_start = (i > 0) ? tokens[i - 1].original_end : 0;
+		size_t punct_len = text.size() - punct_start;
 
-				std::cout << res[i].text;
+		if (punct_len > 0)
+		{
+			out.append(text, punct_start, punct_len);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < tokens.size(); ++i)
+		{
+			if (i > 0)
+			{
+				out += '\t';
 			}
 
-			size_t punct_start = (i > 0) ? res[i - 1].original_end : 0;
-			size_t punct_len = text.size() - punct_start;
+			out += (opts.format == FORMAT_VERBOSE) ? tokens[i].to_string() : tokens[i].text;
+		}
+	}
+}
+
+/*
+** tokenize standard input line by line
+** input is read in chunks of whatever is available (so interactive use still works), complete lines
+** of a chunk are tokenized on all workers and their outputs are written in input order with one flush per chunk
+*/
+int process_stream(const tokenizer_option &opts)
+{
+	static const size_t CHUNK_SIZE = 1 << 22;
 
-			if (punct_len > 0)
+	WorkStealingPool pool(opts.threads);
+	std::vector< std::vector< FullToken > > worker_tokens(pool.size());
+	std::vector< std::string > lines;
+	std::vector< std::string > results;
+	std::vector< char > chunk(CHUNK_SIZE);
+	std::string pending; // input after the last complete line
+	std::string output;
+
+	bool eof = false;
+	while (!eof)
+	{
+		ssize_t read_size = read(STDIN_FILENO, chunk.data(), CHUNK_SIZE);
+		if (read_size < 0)
+		{
+			if (errno == EINTR) continue;
+			perror("Cannot read standard input");
+			return -1;
+		}
+		eof = read_size == 0;
+		pending.append(chunk.data(), read_size);
+
+		size_t line_count = 0;
+		size_t line_start = 0;
+		while (line_start < pending.size())
+		{
+			size_t line_end = pending.find('\n', line_start);
+			if (line_end == std::string::npos)
 			{
-				std::cout << text.substr(punct_start, punct_len);
+				if (!eof) break;
+				line_end = pending.size(); // last line without line break
 			}
+			if (line_count == lines.size()) lines.push_back(std::string());
+			lines[line_count++].assign(pending, line_start, line_end - line_start);
+			line_start = line_end + 1;
 		}
-		else
-		{
-			for (size_t i = 0; i < res.size(); ++i)
+		pending.erase(0, std::min(line_start, pending.size()));
+		if (line_count == 0) continue;
+
+		if (results.size() < line_count) results.resize(line_count);
+		pool.parallel_for(line_count,
+			[&opts, &lines, &results, &worker_tokens](int worker, size_t index)
 			{
-				if (i > 0)
-				{
-					std::cout << '\t';
-				}
+				results[index].clear();
+				format_line(lines[index], opts, worker_tokens[worker], results[index]);
+			});
 
-				std::cout << ((opts.format == FORMAT_VERBOSE) ? res[i].to_string() : res[i].text);
-			}
+		output.clear();
+		for (size_t i = 0; i < line_count; ++i)
+		{
+			output += results[i];
+			output += '\n';
+		}
+		if (fwrite(output.data(), 1, output.size(), stdout) != output.size() || fflush(stdout) != 0)
+		{
+			perror("Cannot write standard output");
+			return -1;
 		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	tokenizer_option opts;
 
-		std::cout << std::endl;
-	};
+	if (tokenizer_getopt_parse(argc, argv, opts))
+	{
+		print_tokenizer_usage(argc, argv);
+		exit(EXIT_FAILURE);
+	}
+
+	if (0 > Tokenizer::instance().initialize(opts.dict_path, !opts.no_sticky, opts.use_mmap))
+	{
+		exit(EXIT_FAILURE);
+	}
+	Tokenizer::instance().set_sticky_cache_capacity(opts.sticky_cache);
+	Tokenizer::instance().set_query_cache_capacity(opts.query_cache);
 
+	std::vector< FullToken > tokens;
+	std::string output;
 	for (int i = optind; i < argc; ++i)
 	{
-		process(argv[i]);
+		output.clear();
+		format_line(argv[i], opts, tokens, output);
+		output += '\n';
+		fwrite(output.data(), 1, output.size(), stdout);
 	}
 
 	if (optind == argc)
 	{
-		std::string line;
-		while (std::getline(std::cin, line))
+		if (0 > process_stream(opts))
 		{
-			process(line);
+			exit(EXIT_FAILURE);
 		}
 	}
 
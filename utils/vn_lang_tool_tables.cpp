@@ -0,0 +1,140 @@
+// Generates vn_lang_tool_tables.h, the precompiled VnLangTool tables, from dicts/vn_lang_tool
+// The tables written out are built from the files at runtime, as without precompiled tables
+#define VN_LANG_TOOL_NO_PRECOMPILED
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <tokenizer/auxiliary/vn_lang_tool.hpp>
+
+template < class T >
+void write_staged_table(FILE *out, const char *c_type, const char *name, const VnLangTool::StagedTable< T > &table)
+{
+	fprintf(out, "const uint16_t %s_pages[%d] = {", name, VnLangTool::STAGE_PAGE_COUNT);
+	for (int i = 0; i < VnLangTool::STAGE_PAGE_COUNT; ++i)
+	{
+		fprintf(out, "%s%d,", i % 16 == 0 ? "\n\t" : " ", (int) table.page_index[i]);
+	}
+	fprintf(out, "\n};\n");
+
+	int size = table.block_count() * VnLangTool::STAGE_BLOCK_SIZE;
+	fprintf(out, "const %s %s_blocks[%d] = {", c_type, name, size);
+	for (int i = 0; i < size; ++i)
+	{
+		fprintf(out, "%s%d,", i % 16 == 0 ? "\n\t" : " ", (int) table.blocks[i]);
+	}
+	fprintf(out, "\n};\n\n");
+}
+
+template < int N >
+void write_forms(FILE *out, const char *name, const uint32_t (*forms)[N])
+{
+	fprintf(out, "const uint32_t %s[24][%d] = {\n", name, N);
+	for (int i = 0; i < 24; ++i)
+	{
+		fprintf(out, "\t{");
+		for (int j = 0; j < N; ++j)
+		{
+			fprintf(out, "%s%u", j > 0 ? ", " : "", forms[i][j]);
+		}
+		fprintf(out, "},\n");
+	}
+	fprintf(out, "};\n\n");
+}
+
+// every byte as an octal escape, keys may contain NULs
+void write_string_literal(FILE *out, const std::string &s)
+{
+	fprintf(out, "\"");
+	for (unsigned char c : s)
+	{
+		fprintf(out, "\\%03o", c);
+	}
+	fprintf(out, "\", %zu", s.size());
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr,
+			"Usage:\n"
+			"    %s {VN_LANG_TOOL_DICT_PATH} {OUTPUT_HEADER}\n"
+			"\n",
+			argv[0]);
+		return -1;
+	}
+	std::string dict_path = argv[1];
+
+	const char *file_names[] = {"alphabetic", "numeric", "d_and_gi.txt", "i_and_y.txt"};
+	const char *crc_names[] = {"alphabetic_crc", "numeric_crc", "d_and_gi_crc", "i_and_y_crc"};
+	std::string sources[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		if (0 > VnLangTool::read_source(dict_path + "/" + file_names[i], sources[i]))
+		{
+			fprintf(stderr, "Error openning file, %s\n", file_names[i]);
+			return -1;
+		}
+	}
+	if (0 > VnLangTool::init_from_sources(sources[0], sources[1], sources[2], sources[3])) return -1;
+
+	FILE *out = fopen(argv[2], "w");
+	if (out == nullptr)
+	{
+		fprintf(stderr, "Cannot open file for writing %s\n", argv[2]);
+		return -1;
+	}
+
+	fprintf(out,
+		"// Generated by vn_lang_tool_tables from dicts/vn_lang_tool, do not edit\n"
+		"// Included inside namespace VnLangTool by vn_lang_tool.hpp\n"
+		"\n"
+		"namespace Precompiled\n"
+		"{\n");
+	for (int i = 0; i < 4; ++i)
+	{
+		fprintf(out, "const uint32_t %s = %uu;\n", crc_names[i], CRC32::crc32(sources[i].data(), sources[i].size()));
+	}
+	fprintf(out, "const bool plain_ascii = %s;\n\n", VnLangTool::plain_ascii ? "true" : "false");
+
+	write_staged_table(out, "uint8_t", "char_class", VnLangTool::char_class);
+	write_staged_table(out, "int32_t", "lower_delta", VnLangTool::lower_delta);
+	write_staged_table(out, "int32_t", "upper_delta", VnLangTool::upper_delta);
+	write_staged_table(out, "int32_t", "root_delta", VnLangTool::root_delta);
+	write_staged_table(out, "int32_t", "lower_root_delta", VnLangTool::lower_root_delta);
+	write_staged_table(out, "int8_t", "tone_id_of", VnLangTool::tone_id_of);
+	write_staged_table(out, "int8_t", "hat_id_of", VnLangTool::hat_id_of);
+	write_staged_table(out, "int8_t", "tone_form_of", VnLangTool::tone_form_of);
+	write_staged_table(out, "int8_t", "hat_form_of", VnLangTool::hat_form_of);
+
+	write_forms(out, "tone_forms", VnLangTool::tone_forms_UTF);
+	write_forms(out, "hat_forms", VnLangTool::hat_forms_UTF);
+
+	// sorted, so that the output only depends on the sources
+	std::vector< std::pair< std::string, std::string > > transformations(
+		VnLangTool::transformation.begin(), VnLangTool::transformation.end());
+	std::sort(transformations.begin(), transformations.end());
+	fprintf(out, "const int transformation_count = %zu;\n", transformations.size());
+	fprintf(out, "const PrecompiledTransformation transformations[] = {\n");
+	for (const std::pair< std::string, std::string > &pair : transformations)
+	{
+		fprintf(out, "\t{");
+		write_string_literal(out, pair.first);
+		fprintf(out, ", ");
+		write_string_literal(out, pair.second);
+		fprintf(out, "},\n");
+	}
+	// never empty
+	fprintf(out, "\t{nullptr, 0, nullptr, 0}\n};\n");
+	fprintf(out, "} // namespace Precompiled\n");
+
+	bool ok = ferror(out) == 0;
+	if (fclose(out) != 0 || !ok)
+	{
+		fprintf(stderr, "Cannot write %s\n", argv[2]);
+		return -1;
+	}
+	return 0;
+}